@@ -0,0 +1,66 @@
+/*
+    Region allocator for everything that lives as long as one compilation: AST nodes, symbols,
+    NFA states, transitions and their strings. An allocation bumps an offset inside the newest
+    block, and blocks double in size, so a whole arena goes back to the system with a handful of
+    free() calls instead of a walk over the graphs it holds.
+*/
+
+#define ARENA_MIN_BLOCK 65536 // bytes of the first block
+#define ARENA_MAX_BLOCK (64L << 20) // blocks stop doubling here
+#define ARENA_ALIGN 16 // every allocation starts on this boundary
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev; // older blocks
+    size_t used;
+    size_t size;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *block; // newest block, the only one still filled
+    size_t next; // size of the next block, 0 before the first
+} Arena;
+
+Arena astArena = { NULL, 0 }; // AST nodes and the symbol tables, released by cleanUp()
+Arena nfaArena = { NULL, 0 }; // States and Transitions, released once the code is written
+
+void *arenaAlloc(Arena *a, size_t n) {
+    n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock *b = a->block;
+    if (b == NULL || b->size - b->used < n) {
+        size_t size = a->next ? a->next : ARENA_MIN_BLOCK;
+        while (size < n) size *= 2;
+        b = (ArenaBlock *)malloc(sizeof(ArenaBlock) + size);
+        if (b == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(1);
+        }
+        b->prev = a->block;
+        b->used = 0;
+        b->size = size;
+        a->block = b;
+        a->next = size < ARENA_MAX_BLOCK ? size * 2 : size;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+void *arenaCalloc(Arena *a, size_t n) {
+    return memset(arenaAlloc(a, n), 0, n);
+}
+
+char *arenaStrdup(Arena *a, const char *s) {
+    size_t n = strlen(s) + 1;
+    return (char *)memcpy(arenaAlloc(a, n), s, n);
+}
+
+// everything allocated from a at once
+void arenaRelease(Arena *a) {
+    for (ArenaBlock *b = a->block, *prev; b; b = prev) {
+        prev = b->prev;
+        free(b);
+    }
+    a->block = NULL;
+    a->next = 0;
+}
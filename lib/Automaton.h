@@ -0,0 +1,44 @@
+/*
+    Binary automaton file written by generate --save and read by the generic runner
+    (runner/runner.c). It is the minimized DFA of the --dfa backend, with & and ! already folded
+    into the accept flags, laid out so the runner can use the mapped file in place:
+
+        AutomatonHeader
+        uint32_t table[states * classes]   next state for each state and byte class
+        uint8_t accept[states]             1 when the input matches if it ends in that state
+
+    Numbers are little endian. Readers must reject any other magic or version.
+*/
+
+#include <stdint.h>
+
+#define AUTOMATON_MAGIC "REXECFSM" // first 8 bytes of the file
+#define AUTOMATON_VERSION 1 // bumped whenever the layout changes
+
+typedef struct AutomatonHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t states; // rows of the table
+    uint32_t classes; // columns of the table
+    uint32_t start; // state before the first byte
+    uint32_t settled; // states below this id are dead or accept everything
+    uint32_t reserved; // 0, keeps the class map 8 byte aligned
+    uint8_t byteClass[256]; // byte equivalence class of every byte
+} AutomatonHeader;
+
+// a little endian number of the file as a host number, on any host
+static inline uint32_t automatonLe32(const void *p) {
+    const uint8_t *b = (const uint8_t *)p;
+    return b[0] | b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+// 1 when host numbers are laid out like the file's, so the table can be used in place
+static inline int automatonHostOrder(void) {
+    const uint32_t one = 1;
+    return automatonLe32(&one) == 1;
+}
+
+// total file size for a header, so truncated files are caught before they are used
+static inline uint64_t automatonSize(const AutomatonHeader *h) {
+    return sizeof(AutomatonHeader) + (uint64_t)h->states * h->classes * sizeof(uint32_t) + h->states;
+}
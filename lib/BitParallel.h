@@ -0,0 +1,211 @@
+/*
+    Bit parallel matcher for small patterns. Every edge of the lowered NFA from DFA.h is a
+    Glushkov position, plus position 0 standing for the start. When all of them fit in a
+    uint64_t the frontier is a single word, and one byte is consumed with
+        d = follow(d) & byte_mask[c]
+    where follow(d) is assembled from one table lookup per 8 bit slice of d. No pointers are
+    chased in the inner loop. The sub regexes of & and ! own disjoint positions, so they all
+    run in the same word and only the final accept test looks at them one by one.
+*/
+
+#define BIT_POSITIONS 64 // width of the frontier word
+
+int bitParallel = 1; // try this matcher before the linked NFA runner, cleared by --nfa
+
+// Positions reachable from the closure of the seed states; the position p is added to the
+// accept mask of every sub regex whose accept state is in that closure
+unsigned long long followOf(int *seed, int seedCount, int *edgeBase, int *set, int p,
+    unsigned long long *acceptMask) {
+    unsigned long long mask = 0;
+    int n = epsilonClosure(seed, seedCount, set);
+    for (int i = 0; i < n; i++) {
+        int k = edgeBase[set[i]];
+        for (ByteEdge *e = byteStates[set[i]].edges; e; e = e->next) mask |= 1ULL << k++;
+        if (acceptSub[set[i]] >= 0) acceptMask[acceptSub[set[i]]] |= 1ULL << p;
+    }
+    return mask;
+}
+
+#define UNIVERSAL_LIMIT 4096 // frontiers explored before a position is assumed not universal
+
+// A position is universal for its sub regex when every frontier reachable from it accepts, so
+// once it shows up in the frontier that sub accepts whatever follows
+int universalPosition(int p, unsigned long long *follow, unsigned long long *byteMask,
+    unsigned long long accept, int positions) {
+    unsigned long long *seen = (unsigned long long *)malloc(UNIVERSAL_LIMIT * sizeof(unsigned long long));
+    int count = 0, universal = 1;
+    seen[count++] = 1ULL << p;
+    for (int i = 0; i < count && universal; i++) {
+        unsigned long long d = seen[i], f = 0;
+        if (!(d & accept)) { universal = 0; break; }
+        for (int q = 0; q < positions; q++)
+            if (d & (1ULL << q)) f |= follow[q];
+        for (int c = 0; c < 256 && universal; c++) {
+            unsigned long long next = f & byteMask[c];
+            int known = 0;
+            for (int j = 0; j < count && !known; j++) known = seen[j] == next;
+            if (known) continue;
+            if (count == UNIVERSAL_LIMIT) universal = 0;
+            else seen[count++] = next;
+        }
+    }
+    free(seen);
+    return universal;
+}
+
+// Emit the bit parallel rexec.c; returns 0 without writing anything when the pattern needs
+// more than BIT_POSITIONS positions
+int bitParallelCode(FILE *file) {
+    prepareLowered();
+    int *edgeBase = (int *)malloc((byteCount + 1) * sizeof(int));
+    int positions = 1; // position 0 is the start
+    for (int s = 0; s < byteCount; s++) {
+        edgeBase[s] = positions;
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next) positions++;
+    }
+    edgeBase[byteCount] = positions;
+    if (dfaStats) printf("Bit parallel positions: %d\n", positions);
+    if (positions > BIT_POSITIONS) {
+        free(edgeBase);
+        freeDfa();
+        return 0;
+    }
+
+    unsigned long long follow[BIT_POSITIONS] = {0}; // positions that may come right after each one
+    unsigned long long byteMask[256] = {0}; // positions whose label holds the byte
+    unsigned long long acceptMask[MAX_SUBNFAS] = {0}; // positions after which each sub may end
+    int *set = (int *)malloc(byteCount * sizeof(int));
+    int *seed = (int *)malloc(byteCount * sizeof(int));
+    for (int i = 0; i < startCount; i++) seed[i] = startStates[i]->id;
+    follow[0] = followOf(seed, startCount, edgeBase, set, 0, acceptMask);
+    for (int s = 0; s < byteCount; s++) {
+        int p = edgeBase[s];
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next, p++) {
+            follow[p] = followOf(&e->to, 1, edgeBase, set, p, acceptMask);
+            for (int c = 0; c < 256; c++)
+                if (BIT_TEST(e->set, c)) byteMask[c] |= 1ULL << p;
+        }
+    }
+    int slices = (positions + 7) / 8;
+
+    // positions of each sub regex (the start belongs to all of them) and the universal ones
+    unsigned long long subMask[MAX_SUBNFAS], universalMask[MAX_SUBNFAS] = {0};
+    for (int i = 0; i < startCount; i++) subMask[i] = 1;
+    for (int s = 0; s < byteCount; s++) {
+        int p = edgeBase[s];
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next, p++) {
+            if (ownerSub[s] < 0) continue; // unreachable from any start
+            subMask[ownerSub[s]] |= 1ULL << p;
+            if (universalPosition(p, follow, byteMask, acceptMask[ownerSub[s]], positions))
+                universalMask[ownerSub[s]] |= 1ULL << p;
+        }
+    }
+
+    fprintf(file,
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n"
+        "#include <stdint.h>\n\n"
+    );
+    fprintf(file, "#define NUM_POSITIONS %d // Glushkov positions, one bit each\n", positions);
+    fprintf(file, "#define REENTRANT_MATCH // scan() only reads the tables\n\n");
+
+    // 1) Positions accepting each byte, then the follow sets unioned per 8 bit slice of the frontier
+    fprintf(file, "static const uint64_t byte_mask[256] = {");
+    for (int c = 0; c < 256; c++)
+        fprintf(file, "%s0x%llxULL%s", (c % 8 == 0 ? "\n    " : ""), byteMask[c], (c + 1 < 256 ? "," : ""));
+    fprintf(file, "\n};\n\n");
+
+    fprintf(file, "static const uint64_t follow[%d][256] = {\n", slices);
+    for (int k = 0; k < slices; k++) {
+        fprintf(file, "    {");
+        for (int v = 0; v < 256; v++) {
+            unsigned long long mask = 0;
+            for (int b = 0; b < 8; b++)
+                if (v & (1 << b) && k * 8 + b < positions) mask |= follow[k * 8 + b];
+            fprintf(file, "%s0x%llxULL%s", (v % 8 == 0 ? "\n        " : ""), mask, (v + 1 < 256 ? "," : ""));
+        }
+        fprintf(file, "\n    }%s\n", (k + 1 < slices ? "," : ""));
+    }
+    fprintf(file, "};\n\n");
+
+    // 2) Accept, own and universal positions and invert flag of each sub regex of & and !
+    fprintf(file, "#define SUBS %d\n", startCount);
+    fprintf(file, "static const uint64_t accept_mask[SUBS] = {");
+    for (int i = 0; i < startCount; i++)
+        fprintf(file, "0x%llxULL%s", acceptMask[i], (i + 1 < startCount ? ", " : ""));
+    fprintf(file, "};\n");
+    fprintf(file, "static const uint64_t sub_mask[SUBS] = {");
+    for (int i = 0; i < startCount; i++)
+        fprintf(file, "0x%llxULL%s", subMask[i], (i + 1 < startCount ? ", " : ""));
+    fprintf(file, "};\n");
+    fprintf(file, "static const uint64_t universal_mask[SUBS] = {");
+    for (int i = 0; i < startCount; i++)
+        fprintf(file, "0x%llxULL%s", universalMask[i], (i + 1 < startCount ? ", " : ""));
+    fprintf(file, "};\n");
+    fprintf(file, "static const unsigned char invert[SUBS] = {");
+    for (int i = 0; i < startCount; i++)
+        fprintf(file, "%d%s", invertFlags[i], (i + 1 < startCount ? ", " : ""));
+    fprintf(file, "};\n\n");
+
+    // 3) Runner: shift/and/or over the frontier word, one lookup per slice
+    fprintf(file,
+        "// a sub regex is settled once its positions are gone (it rejects from now on) or one of them\n"
+        "// is universal (it accepts); the verdict is fixed when one settled sub fails the & or all are settled\n"
+        "static inline int settled(uint64_t d) {\n"
+        "    int open = 0;\n"
+        "    for (int k = 0; k < SUBS; k++) {\n"
+        "        uint64_t live = d & sub_mask[k];\n"
+        "        if (live && !(live & universal_mask[k])) { open = 1; continue; }\n"
+        "        if ((live != 0) == invert[k]) return 1;\n"
+        "    }\n"
+        "    return !open;\n"
+        "}\n\n"
+
+        "#define SETTLE_BLOCK 64 // bytes between two settled() checks, a settled frontier stays so\n\n"
+        "// advance the frontier over one chunk and return it, stopping early once the verdict is settled\n"
+        "uint64_t scan(const unsigned char *input, long len, uint64_t d) {\n"
+        "    for (long i = 0; i < len && !settled(d); ) {\n"
+        "        long end = len - i < SETTLE_BLOCK ? len : i + SETTLE_BLOCK;\n"
+        "        for (; i < end; ++i) {\n"
+        "            uint64_t f = follow[0][d & 0xff]"
+    );
+    for (int k = 1; k < slices; k++)
+        fprintf(file, "\n                | follow[%d][(d >> %d) & 0xff]", k, k * 8);
+    fprintf(file,
+        ";\n"
+        "            d = f & byte_mask[input[i]];\n"
+        "        }\n"
+        "    }\n"
+        "    return d;\n"
+        "}\n\n"
+    );
+
+    // 4) one pass over the input, then every sub regex must accept (or not, when inverted)
+    fprintf(file,
+        "int verdict(uint64_t d) {\n"
+        "    for (int k = 0; k < SUBS; k++)\n"
+        "        if (((d & accept_mask[k]) != 0) == invert[k]) return 0;\n"
+        "    return 1;\n"
+        "}\n\n"
+
+        "#define CHUNK_SIZE 65536 // bytes read from the input at a time\n\n"
+        "int match_stream(FILE *f) {\n"
+        "    static unsigned char buf[CHUNK_SIZE];\n"
+        "    uint64_t state = 1; // the start position\n"
+        "    size_t n;\n"
+        "    while (!settled(state) && (n = fread(buf, 1, CHUNK_SIZE, f)) > 0) state = scan(buf, n, state);\n"
+        "    return verdict(state);\n"
+        "}\n\n"
+
+        "int match_record(const unsigned char *input, long len) {\n"
+        "    return verdict(scan(input, len, 1));\n"
+        "}\n\n"
+    );
+    mainCode(file, 0);
+    free(set);
+    free(seed);
+    free(edgeBase);
+    freeDfa();
+    return 1;
+}
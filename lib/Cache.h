@@ -0,0 +1,224 @@
+/*
+    Content addressed compile cache. The key is a 64 bit FNV-1a hash of the generator version,
+    the options that change the output and the AST of the root regex with every symbol replaced
+    by its definition, so renaming a symbol or reformatting the pattern file still hits. Each
+    output file is kept in the cache directory as <key><extension> (rexec.c as <key>.c).
+
+    Outputs are written to temporary files first and only replace the real file when the text
+    differs, so an unchanged pattern keeps the old timestamp and make does not rebuild rexec.
+*/
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define GENERATOR_VERSION "rexec-gen 8" // bump whenever the emitted code changes for the same input
+#define MAX_OUTPUTS 2 // rexec.c plus rexec.h for --lib
+
+char *cacheDir = NULL; // --cache-dir=DIR or $REXEC_CACHE_DIR, no caching when NULL
+char cacheKey[17] = ""; // hex key of the current pattern once cachedOutput() ran
+unsigned long long patternHash = 14695981039346656037ULL; // every pattern given to hashPattern()
+
+typedef struct Output {
+    FILE *file; // temporary file the generator writes to
+    char path[256]; // real destination, replaced on closeOutputs()
+} Output;
+
+Output outputs[MAX_OUTPUTS];
+int outputCount = 0;
+
+void hashBytes(unsigned long long *h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        *h ^= p[i];
+        *h *= 1099511628211ULL;
+    }
+}
+
+void hashString(unsigned long long *h, const char *s) {
+    hashBytes(h, s ? s : "", s ? strlen(s) + 1 : 1); // the terminator keeps "ab","c" apart from "a","bc"
+}
+
+// One step of hashAST(): a node to hash, or the end of the definition leave was substituted for
+typedef struct HashStep {
+    ASTNode *node;
+    ASTNode *leave;
+} HashStep;
+
+// the tree as the generator sees it: substitutions are followed, their names are not hashed.
+// The walk keeps its own stack, so no subtree is left out however deep the pattern nests; a
+// definition met again inside its own expansion hashes as a reference to it instead
+void hashAST(unsigned long long *h, ASTNode *root, Symbol *symbolTable) {
+    int cap = 64, top = 0, depth = 0, depthCap = 16;
+    HashStep *stack = (HashStep *)malloc(cap * sizeof(HashStep));
+    ASTNode **open = (ASTNode **)malloc(depthCap * sizeof(ASTNode *)); // definitions being expanded
+    int ok = stack && open;
+    if (ok) stack[top++] = (HashStep){ root, NULL };
+    while (top > 0) {
+        HashStep step = stack[--top];
+        if (step.leave) {
+            depth--;
+            continue;
+        }
+        ASTNode *node = step.node;
+        if (top + 2 > cap) {
+            HashStep *grown = (HashStep *)realloc(stack, 2 * cap * sizeof(HashStep));
+            if (!grown) { ok = 0; break; }
+            stack = grown;
+            cap *= 2;
+        }
+        if (node == NULL) {
+            hashString(h, "-");
+        }
+        else if (node->kind == NODE_SUBSTITUTE) {
+            ASTNode *def = getSymbol(node->left->value, symbolTable);
+            int back = depth;
+            while (back > 0 && open[back - 1] != def) back--;
+            if (def && back > 0) { // distance to the enclosing expansion of def
+                int distance = depth - back;
+                hashString(h, "<ref>");
+                hashBytes(h, &distance, sizeof(distance));
+                continue;
+            }
+            if (depth == depthCap) {
+                ASTNode **grown = (ASTNode **)realloc(open, 2 * depthCap * sizeof(ASTNode *));
+                if (!grown) { ok = 0; break; }
+                open = grown;
+                depthCap *= 2;
+            }
+            open[depth++] = def;
+            stack[top++] = (HashStep){ NULL, def ? def : node }; // pops the expansion again
+            stack[top++] = (HashStep){ def, NULL };
+        }
+        else if (node->kind == NODE_SYSTEM) { // definitions count where they are substituted
+            stack[top++] = (HashStep){ node->right, NULL };
+        }
+        else {
+            hashBytes(h, &node->kind, sizeof(node->kind));
+            hashString(h, node->value);
+            stack[top++] = (HashStep){ node->right, NULL };
+            stack[top++] = (HashStep){ node->left, NULL };
+        }
+    }
+    if (!ok) cacheDir = NULL; // out of memory: no key rather than a wrong one
+    free(stack);
+    free(open);
+}
+
+// add one more pattern (all the systems of the file with --set) to the key
+void hashPattern(ASTNode *root, Symbol *symbolTable) {
+    hashAST(&patternHash, root, symbolTable);
+}
+
+// temporary stand in for path; NULL when it cannot be created
+FILE *openOutput(const char *path) {
+    if (outputCount == MAX_OUTPUTS || strlen(path) >= sizeof(outputs[0].path)) return NULL;
+    FILE *f = tmpfile();
+    if (!f) return NULL;
+    outputs[outputCount].file = f;
+    strcpy(outputs[outputCount].path, path);
+    outputCount++;
+    return f;
+}
+
+const char *outputExtension(const Output *out) {
+    const char *dot = strrchr(out->path, '.');
+    return dot && !strchr(dot, '/') ? dot : "";
+}
+
+// copy the rest of from into to; 0 on a read or write error
+int copyStream(FILE *from, FILE *to) {
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+        if (fwrite(buf, 1, n, to) != n) return 0;
+    return !ferror(from);
+}
+
+// 1 when the file at path holds exactly the bytes of f
+int sameContent(FILE *f, const char *path) {
+    FILE *old = fopen(path, "rb");
+    if (!old) return 0;
+    char a[65536], b[65536];
+    size_t n, m;
+    int same = 1;
+    rewind(f);
+    do {
+        n = fread(a, 1, sizeof(a), f);
+        m = fread(b, 1, sizeof(b), old);
+        same = n == m && memcmp(a, b, n) == 0;
+    } while (same && n > 0);
+    fclose(old);
+    return same;
+}
+
+// write f to path through a temporary name and rename, so readers never see half a file
+int replaceFile(FILE *f, const char *path) {
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *out = fopen(tmp, "wb");
+    if (!out) return 0;
+    rewind(f);
+    int ok = copyStream(f, out);
+    ok = fclose(out) == 0 && ok;
+    if (ok && rename(tmp, path) == 0) return 1;
+    remove(tmp);
+    return 0;
+}
+
+// Key of the hashed patterns, then the cached outputs copied in when all of them are there;
+// returns 1 on a hit
+int cachedOutput() {
+    if (!cacheDir || dfaStats || outputCount == 0) return 0; // --stats needs the real build
+    unsigned long long h = patternHash;
+    int options[] = { genMode, bitParallel, prefilterEnabled, setMode };
+    hashString(&h, GENERATOR_VERSION);
+    hashBytes(&h, options, sizeof(options));
+    hashBytes(&h, &lazyCacheBudget, sizeof(lazyCacheBudget));
+    snprintf(cacheKey, sizeof(cacheKey), "%016llx", h);
+
+    FILE *cached[MAX_OUTPUTS];
+    int hit = 1;
+    for (int i = 0; i < outputCount; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%s", cacheDir, cacheKey, outputExtension(&outputs[i]));
+        cached[i] = hit ? fopen(path, "rb") : NULL;
+        if (!cached[i]) hit = 0;
+    }
+    for (int i = 0; i < outputCount && hit; i++) hit = copyStream(cached[i], outputs[i].file);
+    for (int i = 0; i < outputCount; i++) {
+        if (cached[i]) fclose(cached[i]);
+        if (!hit) { // start over from empty outputs
+            fflush(outputs[i].file);
+            if (ftruncate(fileno(outputs[i].file), 0) != 0) return 0;
+            rewind(outputs[i].file);
+        }
+    }
+    return hit;
+}
+
+// keep freshly generated outputs under the key from cachedOutput(); a failure only costs the cache
+void storeOutput() {
+    if (!cacheDir || !cacheKey[0]) return;
+    mkdir(cacheDir, 0777);
+    for (int i = 0; i < outputCount; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%s", cacheDir, cacheKey, outputExtension(&outputs[i]));
+        if (!replaceFile(outputs[i].file, path)) return;
+    }
+}
+
+// Move the finished outputs to their paths when write is set (only those whose text changed),
+// otherwise drop them; returns 0 when one could not be written
+int closeOutputs(int write) {
+    int ok = 1;
+    for (int i = 0; i < outputCount; i++) {
+        fflush(outputs[i].file);
+        if (write && !sameContent(outputs[i].file, outputs[i].path) && !replaceFile(outputs[i].file, outputs[i].path)) {
+            perror(outputs[i].path);
+            ok = 0;
+        }
+        fclose(outputs[i].file);
+    }
+    outputCount = 0;
+    return ok;
+}
@@ -0,0 +1,802 @@
+/*
+    Subset construction over the NFA built by generateStates(). The NFA is first lowered to a
+    byte level automaton (one byte per edge, epsilon lists kept apart) and then determinized
+    into a dense table that the generated rexec.c walks with one lookup per input byte.
+    Columns are byte equivalence classes rather than raw bytes to keep the table small.
+    The sub regexes of & and ! are determinized together as one product automaton: a DFA state
+    holds NFA states of every sub, and it accepts when each sub accepts unless inverted.
+*/
+
+#define DFA_STATE_LIMIT 65536 // upper bound on determinized states before we give up
+
+// Lowered NFA edge: a set of bytes (256 bit bitmap) leading to one state
+typedef struct ByteEdge {
+    unsigned char set[32]; // bit c is set when byte c is accepted on this edge
+    int to; // index of the target byte state
+    struct ByteEdge *next; // linked list of edges
+} ByteEdge;
+
+// Lowered NFA state
+typedef struct ByteState {
+    int *eps; // epsilon targets
+    int epsCount;
+    int epsCap;
+    ByteEdge *edges; // byte consuming edges
+    int is_accept;
+} ByteState;
+
+ByteState *byteStates = NULL; // lowered NFA, indexed by State id and then by extra chain states
+int byteCount = 0;
+int byteCap = 0;
+int *acceptSub = NULL; // for each byte state, the sub regex it is the accept state of, or -1
+int *ownerSub = NULL; // for each byte state, the sub regex whose NFA it belongs to
+
+// Determinized automaton, state 0 is always the dead state (empty set)
+int dfaCount = 0;
+int dfaCap = 0;
+int *dfaTable = NULL; // dfaCount * classCount transitions
+int *dfaAccept = NULL; // 1 if the state holds an accepting NFA state
+int **dfaSets = NULL; // sorted NFA state set for each DFA state
+int *dfaSetSize = NULL;
+int dfaStart = 0; // DFA state holding the start of every sub regex
+int terminalCount = 1; // states below this id settle the verdict, nothing read later changes it
+
+// Byte equivalence classes: bytes no edge label can tell apart share a class, so tables only
+// need one column per class instead of one per byte
+int byteClass[256];
+int classRep[256]; // one representative byte for each class
+int classCount = 0;
+
+// open addressing hash from NFA state set to DFA state
+int *dfaHash = NULL;
+int dfaHashCap = 0;
+
+int newByteState() {
+    if (byteCount == byteCap) {
+        byteCap = byteCap ? byteCap * 2 : 256;
+        byteStates = (ByteState *)realloc(byteStates, byteCap * sizeof(ByteState));
+    }
+    ByteState *b = &byteStates[byteCount];
+    b->eps = NULL;
+    b->epsCount = 0;
+    b->epsCap = 0;
+    b->edges = NULL;
+    b->is_accept = 0;
+    return byteCount++;
+}
+
+void addByteEpsilon(int from, int to) {
+    ByteState *b = &byteStates[from];
+    if (b->epsCount == b->epsCap) {
+        b->epsCap = b->epsCap ? b->epsCap * 2 : 4;
+        b->eps = (int *)realloc(b->eps, b->epsCap * sizeof(int));
+    }
+    b->eps[b->epsCount++] = to;
+}
+
+ByteEdge* addByteEdge(int from, int to) {
+    ByteEdge *e = (ByteEdge *)calloc(1, sizeof(ByteEdge));
+    e->to = to;
+    e->next = byteStates[from].edges;
+    byteStates[from].edges = e;
+    return e;
+}
+
+// Lower the State/Transition graph into byteStates. Multi character matches become chains.
+void lowerStates() {
+    for (int i = 0; i < state_id; i++) {
+        newByteState(); // one byte state per State id so both share the same index
+    }
+    for (State *s = all_states; s; s = s->next) {
+        byteStates[s->id].is_accept = s->is_accept;
+
+        for (Transition *t = s->transitions; t; t = t->next) {
+            if (t->match == NULL) {
+                addByteEpsilon(s->id, t->to->id);
+            }
+            else if (t->type == TYPE_CHARSET) {
+                ByteEdge *e = addByteEdge(s->id, t->to->id);
+                memcpy(e->set, t->set, 32);
+            }
+            else {
+                int m = strlen(t->match);
+                if (m == 0) {
+                    addByteEpsilon(s->id, t->to->id);
+                    continue;
+                }
+                int from = s->id;
+                for (int k = 0; k < m; k++) { // one chain state per character but the last
+                    int to = (k == m - 1) ? t->to->id : newByteState();
+                    ByteEdge *e = addByteEdge(from, to);
+                    BIT_SET(e->set, (unsigned char)t->match[k]);
+                    from = to;
+                }
+            }
+        }
+    }
+}
+
+// Refine the 256 bytes by every edge label; two bytes stay together only if every edge
+// either accepts both or neither
+void computeByteClasses() {
+    int remap[512];
+    for (int c = 0; c < 256; c++) byteClass[c] = 0;
+    classCount = 1;
+    for (int i = 0; i < byteCount; i++) {
+        for (ByteEdge *e = byteStates[i].edges; e; e = e->next) {
+            for (int k = 0; k < classCount * 2; k++) remap[k] = -1;
+            int next = 0;
+            for (int c = 0; c < 256; c++) {
+                int key = byteClass[c] * 2 + (BIT_TEST(e->set, c) ? 1 : 0);
+                if (remap[key] < 0) remap[key] = next++;
+                byteClass[c] = remap[key];
+            }
+            classCount = next;
+        }
+    }
+    for (int c = 255; c >= 0; c--) classRep[byteClass[c]] = c; // lowest byte of each class
+}
+
+// scratch for closures and moves
+int *closureMark = NULL; // generation stamp per byte state
+int closureStamp = 0;
+int *closureStack = NULL;
+int *moveMark = NULL; // generation stamp per byte state while collecting a move
+int moveStamp = 0;
+
+int intCompare(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Iterative epsilon closure of the seed states; writes the sorted set to out and returns its size
+int epsilonClosure(int *seed, int seedCount, int *out) {
+    int count = 0, top = 0;
+    closureStamp++;
+    for (int i = 0; i < seedCount; i++) {
+        if (closureMark[seed[i]] != closureStamp) {
+            closureMark[seed[i]] = closureStamp;
+            closureStack[top++] = seed[i];
+        }
+    }
+    while (top > 0) {
+        int s = closureStack[--top];
+        out[count++] = s;
+        for (int k = 0; k < byteStates[s].epsCount; k++) {
+            int t = byteStates[s].eps[k];
+            if (closureMark[t] != closureStamp) {
+                closureMark[t] = closureStamp;
+                closureStack[top++] = t;
+            }
+        }
+    }
+    qsort(out, count, sizeof(int), intCompare);
+    return count;
+}
+
+int setAccept(int *set, int n); // Set.h
+void findSecuringStates(); // Set.h
+int securePatterns(int *set, int n); // Set.h
+
+// A set of NFA states drawn from every sub regex accepts when each sub does (or does not, for
+// the inverted ones of !). With --set the value is the id of the set of patterns accepting.
+int productAccept(int *set, int n) {
+    if (setMode) return setAccept(set, n);
+    char hit[MAX_SUBNFAS] = {0};
+    for (int i = 0; i < n; i++)
+        if (acceptSub[set[i]] >= 0) hit[acceptSub[set[i]]] = 1;
+    for (int i = 0; i < startCount; i++)
+        if (hit[i] == invertFlags[i]) return 0;
+    return 1;
+}
+
+// The single start set: the epsilon closure of every sub regex start
+int startClosure(int *seed, int *out) {
+    for (int i = 0; i < startCount; i++) seed[i] = startStates[i]->id;
+    return epsilonClosure(seed, startCount, out);
+}
+
+unsigned long hashSet(int *set, int n) {
+    unsigned long h = 1469598103934665603UL; // FNV-1a
+    for (int i = 0; i < n; i++) {
+        h ^= (unsigned long)set[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+int addDfaState(int *set, int n); // forward declaration
+
+void growDfaHash() {
+    int oldCap = dfaHashCap;
+    int *old = dfaHash;
+    dfaHashCap = oldCap ? oldCap * 2 : 1024;
+    dfaHash = (int *)malloc(dfaHashCap * sizeof(int));
+    for (int i = 0; i < dfaHashCap; i++) dfaHash[i] = -1;
+    for (int i = 0; i < oldCap; i++) {
+        if (old[i] < 0) continue;
+        unsigned long h = hashSet(dfaSets[old[i]], dfaSetSize[old[i]]) & (dfaHashCap - 1);
+        while (dfaHash[h] >= 0) h = (h + 1) & (dfaHashCap - 1);
+        dfaHash[h] = old[i];
+    }
+    free(old);
+}
+
+// Find the DFA state for a sorted NFA set, creating it when new
+int addDfaState(int *set, int n) {
+    if (dfaCount * 2 >= dfaHashCap) growDfaHash();
+    unsigned long h = hashSet(set, n) & (dfaHashCap - 1);
+    while (dfaHash[h] >= 0) {
+        int d = dfaHash[h];
+        if (dfaSetSize[d] == n && memcmp(dfaSets[d], set, n * sizeof(int)) == 0) return d;
+        h = (h + 1) & (dfaHashCap - 1);
+    }
+    if (dfaCount == DFA_STATE_LIMIT) {
+        fprintf(stderr, "Error: DFA exceeds %d states\n", DFA_STATE_LIMIT);
+        exit(1);
+    }
+    if (dfaCount == dfaCap) {
+        dfaCap = dfaCap ? dfaCap * 2 : 256;
+        dfaTable = (int *)realloc(dfaTable, dfaCap * classCount * sizeof(int));
+        dfaAccept = (int *)realloc(dfaAccept, dfaCap * sizeof(int));
+        dfaSets = (int **)realloc(dfaSets, dfaCap * sizeof(int *));
+        dfaSetSize = (int *)realloc(dfaSetSize, dfaCap * sizeof(int));
+    }
+    int d = dfaCount++;
+    dfaSets[d] = (int *)malloc((n ? n : 1) * sizeof(int));
+    memcpy(dfaSets[d], set, n * sizeof(int));
+    dfaSetSize[d] = n;
+    dfaAccept[d] = productAccept(set, n);
+    dfaHash[h] = d;
+    return d;
+}
+
+// Lower the NFA, split the alphabet into classes and set up the closure scratch
+void prepareLowered() {
+    lowerStates();
+    computeByteClasses();
+    acceptSub = (int *)malloc(byteCount * sizeof(int));
+    for (int s = 0; s < byteCount; s++) acceptSub[s] = -1;
+    for (int i = 0; i < startCount; i++) acceptSub[startStates[i]->pair->id] = i;
+    ownerSub = (int *)malloc(byteCount * sizeof(int));
+    int *stack = (int *)malloc(byteCount * sizeof(int));
+    for (int s = 0; s < byteCount; s++) ownerSub[s] = -1;
+    for (int i = 0; i < startCount; i++) { // the sub NFAs are disjoint, so a walk from each start finds its states
+        int top = 0;
+        stack[top++] = startStates[i]->id;
+        ownerSub[startStates[i]->id] = i;
+        while (top > 0) {
+            int s = stack[--top];
+            for (int k = 0; k < byteStates[s].epsCount; k++) {
+                int t = byteStates[s].eps[k];
+                if (ownerSub[t] < 0) { ownerSub[t] = i; stack[top++] = t; }
+            }
+            for (ByteEdge *e = byteStates[s].edges; e; e = e->next) {
+                if (ownerSub[e->to] < 0) { ownerSub[e->to] = i; stack[top++] = e->to; }
+            }
+        }
+    }
+    free(stack);
+    closureMark = (int *)calloc(byteCount, sizeof(int));
+    closureStack = (int *)malloc(byteCount * sizeof(int));
+    moveMark = (int *)calloc(byteCount, sizeof(int));
+}
+
+// DFA state reached from d on the bytes of class k; seed and set are scratch of byteCount ints
+int dfaMove(int d, int k, int *seed, int *set) {
+    int c = classRep[k]; // every byte of the class moves the same way
+    int seedCount = 0;
+    moveStamp++;
+    for (int i = 0; i < dfaSetSize[d] && dfaSets[d][i] < byteCount; i++) { // --set markers come last
+        for (ByteEdge *e = byteStates[dfaSets[d][i]].edges; e; e = e->next) {
+            if (BIT_TEST(e->set, c) && moveMark[e->to] != moveStamp) {
+                moveMark[e->to] = moveStamp;
+                seed[seedCount++] = e->to;
+            }
+        }
+    }
+    int n = seedCount ? epsilonClosure(seed, seedCount, set) : 0;
+    if (setMode) n = securePatterns(set, n);
+    return addDfaState(set, n);
+}
+
+// Powerset construction from every entry of startStates[]
+void buildDfa() {
+    prepareLowered();
+    int *seed = (int *)malloc(byteCount * sizeof(int));
+    int *set = (int *)malloc((byteCount + (setMode ? MAX_SUBNFAS : 0)) * sizeof(int)); // room for --set markers
+
+    addDfaState(set, 0); // dead state
+    int n = startClosure(seed, set);
+    if (setMode) {
+        findSecuringStates();
+        n = securePatterns(set, n);
+    }
+    dfaStart = addDfaState(set, n);
+
+    for (int d = 0; d < dfaCount; d++) { // dfaCount grows while we walk the worklist
+        for (int k = 0; k < classCount; k++) {
+            int to = dfaMove(d, k, seed, set); // may realloc dfaTable, so store afterwards
+            dfaTable[d * classCount + k] = to;
+        }
+    }
+    free(seed);
+    free(set);
+}
+
+// Hopcroft partition refinement. States are merged when no input can tell them apart, i.e. they
+// start in the same block (same dfaAccept value) and no splitter ever separates them.
+void minimizeDfa() {
+    int n = dfaCount;
+    int *blockOf = (int *)malloc(n * sizeof(int));
+    int *elems = (int *)malloc(n * sizeof(int)); // states ordered by block
+    int *pos = (int *)malloc(n * sizeof(int)); // index of each state in elems
+    int *first = (int *)malloc(n * sizeof(int)); // block range in elems is [first, end)
+    int *end = (int *)malloc(n * sizeof(int));
+    int *marked = (int *)calloc(n, sizeof(int)); // marked prefix length of each block
+    int *touched = (int *)malloc(n * sizeof(int));
+    int *members = (int *)malloc(n * sizeof(int));
+    unsigned char *pending = (unsigned char *)calloc((long)n * classCount, 1); // (block, class) in worklist
+    int *work = (int *)malloc((long)n * classCount * sizeof(int)); // worklist of block * classCount + class
+    int workCount = 0, blocks = 0;
+
+    // inverse transitions per class, stored as predecessor lists (CSR)
+    int *predStart = (int *)calloc((long)n * classCount + 1, sizeof(int));
+    int *preds = (int *)malloc((long)n * classCount * sizeof(int));
+    for (int d = 0; d < n; d++)
+        for (int c = 0; c < classCount; c++) predStart[dfaTable[d * classCount + c] * classCount + c + 1]++;
+    for (long k = 0; k < (long)n * classCount; k++) predStart[k + 1] += predStart[k];
+    int *fill = (int *)malloc((long)n * classCount * sizeof(int));
+    memcpy(fill, predStart, (long)n * classCount * sizeof(int));
+    for (int d = 0; d < n; d++)
+        for (int c = 0; c < classCount; c++) preds[fill[dfaTable[d * classCount + c] * classCount + c]++] = d;
+    free(fill);
+
+    // initial partition: one block per distinct accept value
+    int count = 0;
+    for (int d = 0; d < n; d++) blockOf[d] = -1;
+    for (int d = 0; d < n; d++) {
+        if (blockOf[d] >= 0) continue;
+        first[blocks] = count;
+        for (int e = d; e < n; e++) {
+            if (blockOf[e] < 0 && dfaAccept[e] == dfaAccept[d]) {
+                blockOf[e] = blocks;
+                pos[e] = count;
+                elems[count++] = e;
+            }
+        }
+        end[blocks++] = count;
+    }
+    for (int b = 0; b < blocks; b++) {
+        for (int c = 0; c < classCount; c++) {
+            pending[b * classCount + c] = 1;
+            work[workCount++] = b * classCount + c;
+        }
+    }
+
+    while (workCount > 0) {
+        int w = work[--workCount];
+        int splitter = w / classCount, c = w % classCount;
+        pending[w] = 0;
+
+        // copy the splitter first since marking reorders elems inside blocks
+        int memberCount = 0;
+        for (int k = first[splitter]; k < end[splitter]; k++) members[memberCount++] = elems[k];
+
+        int touchedCount = 0;
+        for (int k = 0; k < memberCount; k++) {
+            int q = members[k];
+            for (int j = predStart[q * classCount + c]; j < predStart[q * classCount + c + 1]; j++) {
+                int p = preds[j];
+                int b = blockOf[p];
+                int slot = first[b] + marked[b];
+                if (pos[p] < slot) continue; // already marked
+                if (marked[b] == 0) touched[touchedCount++] = b;
+                int other = elems[slot]; // swap p into the marked prefix
+                elems[slot] = p;
+                elems[pos[p]] = other;
+                pos[other] = pos[p];
+                pos[p] = slot;
+                marked[b]++;
+            }
+        }
+
+        for (int t = 0; t < touchedCount; t++) {
+            int b = touched[t];
+            int m = marked[b];
+            marked[b] = 0;
+            if (m == end[b] - first[b]) continue; // every state moved the same way
+            int nb = blocks++; // marked prefix becomes the new block
+            first[nb] = first[b];
+            end[nb] = first[b] + m;
+            first[b] = end[nb];
+            for (int k = first[nb]; k < end[nb]; k++) blockOf[elems[k]] = nb;
+            for (int a = 0; a < classCount; a++) {
+                if (pending[b * classCount + a] || end[nb] - first[nb] <= end[b] - first[b]) {
+                    pending[nb * classCount + a] = 1;
+                    work[workCount++] = nb * classCount + a;
+                }
+                else {
+                    pending[b * classCount + a] = 1;
+                    work[workCount++] = b * classCount + a;
+                }
+            }
+        }
+    }
+
+    // renumber blocks so the dead state stays 0, then rebuild the table
+    int *newId = (int *)malloc(blocks * sizeof(int));
+    for (int b = 0; b < blocks; b++) newId[b] = -1;
+    int next = 0;
+    newId[blockOf[0]] = next++;
+    for (int d = 0; d < n; d++)
+        if (newId[blockOf[d]] < 0) newId[blockOf[d]] = next++;
+
+    int *table = (int *)malloc((long)blocks * classCount * sizeof(int));
+    int *accept = (int *)malloc(blocks * sizeof(int));
+    for (int d = 0; d < n; d++) {
+        int nd = newId[blockOf[d]];
+        accept[nd] = dfaAccept[d];
+        for (int c = 0; c < classCount; c++) table[nd * classCount + c] = newId[blockOf[dfaTable[d * classCount + c]]];
+    }
+    dfaStart = newId[blockOf[dfaStart]];
+
+    for (int d = 0; d < n; d++) free(dfaSets[d]);
+    free(dfaSets); free(dfaSetSize); free(dfaHash);
+    dfaSets = NULL; dfaSetSize = NULL; dfaHash = NULL; dfaHashCap = 0;
+    free(dfaTable); free(dfaAccept);
+    dfaTable = table;
+    dfaAccept = accept;
+    dfaCount = dfaCap = blocks;
+
+    free(blockOf); free(elems); free(pos); free(first); free(end); free(marked); free(touched);
+    free(members); free(pending); free(work); free(predStart); free(preds); free(newId);
+}
+
+// Renumber the minimized DFA so the states whose verdict is settled come first: those from which
+// no state with another dfaAccept value can be reached, i.e. dead ones and universal ones (& and !
+// included since dfaAccept is the product accept). State 0, the empty set, is a sink and stays 0.
+void orderTerminals() {
+    int n = dfaCount;
+    int *predStart = (int *)calloc(n + 1, sizeof(int));
+    int *preds = (int *)malloc((long)n * classCount * sizeof(int));
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    for (long k = 0; k < (long)n * classCount; k++) predStart[dfaTable[k] + 1]++;
+    for (int d = 0; d < n; d++) predStart[d + 1] += predStart[d];
+    memcpy(fill, predStart, (n + 1) * sizeof(int));
+    for (long k = 0; k < (long)n * classCount; k++) preds[fill[dfaTable[k]]++] = k / classCount;
+
+    // open[d]: a state with another accept value is reachable from d. It starts at the states
+    // with such a successor and spreads backwards to everything that reaches them
+    unsigned char *open = (unsigned char *)calloc(n, 1);
+    int *queue = (int *)malloc(n * sizeof(int));
+    int head = 0, tail = 0;
+    for (int d = 0; d < n; d++) {
+        for (int c = 0; c < classCount && !open[d]; c++)
+            if (dfaAccept[dfaTable[d * classCount + c]] != dfaAccept[d]) { open[d] = 1; queue[tail++] = d; }
+    }
+    while (head < tail) {
+        int d = queue[head++];
+        for (int j = predStart[d]; j < predStart[d + 1]; j++) {
+            if (!open[preds[j]]) { open[preds[j]] = 1; queue[tail++] = preds[j]; }
+        }
+    }
+
+    int *newId = fill; // reuse as the permutation
+    int next = 0;
+    for (int d = 0; d < n; d++) if (!open[d]) newId[d] = next++;
+    terminalCount = next;
+    for (int d = 0; d < n; d++) if (open[d]) newId[d] = next++;
+
+    int *table = (int *)malloc((long)n * classCount * sizeof(int));
+    int *accept = (int *)malloc(n * sizeof(int));
+    for (int d = 0; d < n; d++) {
+        accept[newId[d]] = dfaAccept[d];
+        for (int c = 0; c < classCount; c++) table[newId[d] * classCount + c] = newId[dfaTable[d * classCount + c]];
+    }
+    dfaStart = newId[dfaStart];
+    free(dfaTable); free(dfaAccept);
+    dfaTable = table;
+    dfaAccept = accept;
+    free(predStart); free(preds); free(fill); free(open); free(queue);
+}
+
+void freeDfa() {
+    for (int i = 0; i < byteCount; i++) {
+        free(byteStates[i].eps);
+        for (ByteEdge *e = byteStates[i].edges, *n; e; e = n) {
+            n = e->next;
+            free(e);
+        }
+    }
+    if (dfaSets) {
+        for (int d = 0; d < dfaCount; d++) free(dfaSets[d]);
+    }
+    free(acceptSub); free(ownerSub); acceptSub = NULL; ownerSub = NULL;
+    free(byteStates); free(dfaTable); free(dfaAccept); free(dfaSets); free(dfaSetSize);
+    free(dfaHash); free(closureMark); free(closureStack); free(moveMark);
+    byteStates = NULL; dfaTable = NULL; dfaAccept = NULL; dfaSets = NULL; dfaSetSize = NULL;
+    dfaHash = NULL; closureMark = NULL; closureStack = NULL; moveMark = NULL;
+    byteCount = byteCap = dfaCount = dfaCap = dfaHashCap = 0;
+}
+
+// smallest C type able to hold a state index
+const char* dfaCellType(int count) {
+    if (count <= 256) return "unsigned char";
+    if (count <= 65536) return "unsigned short";
+    return "int";
+}
+
+// Direct coded matcher: every DFA state becomes a label holding a switch on the next byte that
+// jumps straight to the following state, so the current state lives in the program counter
+void gotoCode(FILE *file) {
+    if (terminalCount == dfaCount) { // the verdict is known before any byte is read
+        fprintf(file,
+            "// every state is settled, nothing is ever read\n"
+            "int scan(const unsigned char *input, long len, int state) {\n"
+            "    (void)input; (void)len;\n"
+            "    return state;\n"
+            "}\n\n"
+        );
+        return;
+    }
+    int *hits = (int *)calloc(dfaCount, sizeof(int)); // bytes leading to each target
+    fprintf(file,
+        "// advance from state over one chunk and return the state reached\n"
+        "int scan(const unsigned char *input, long len, int state) {\n"
+        "    const unsigned char *p = input, *end = input + len;\n"
+        "    switch (state) { // resume where the previous chunk stopped\n"
+    );
+    for (int d = terminalCount; d < dfaCount; d++)
+        fprintf(file, "        case %d: goto s%d;\n", d, d);
+    fprintf(file,
+        "        default: return state; // settled, nothing more to read\n"
+        "    }\n"
+    );
+    for (int d = 0; d < terminalCount; d++)
+        fprintf(file, "s%d:\n    return %d; // %s\n", d, d, dfaAccept[d] ? "accepts whatever follows" : "can never accept");
+    for (int d = terminalCount; d < dfaCount; d++) {
+        int *row = &dfaTable[d * classCount];
+        int fallback = row[byteClass[0]]; // the most common target becomes the default branch
+        for (int c = 0; c < 256; c++) hits[row[byteClass[c]]]++;
+        for (int c = 0; c < 256; c++) {
+            if (hits[row[byteClass[c]]] > hits[fallback]) fallback = row[byteClass[c]];
+        }
+        for (int c = 0; c < 256; c++) hits[row[byteClass[c]]] = 0;
+
+        fprintf(file, "s%d:\n    if (p == end) return %d;\n    switch (*p++) {\n", d, d);
+        for (int k = 0; k < classCount; k++) {
+            if (row[k] == fallback) continue;
+            int printed = 0;
+            for (int c = 0; c < 256; c++) {
+                if (byteClass[c] != k) continue;
+                if (printed % 8 == 0) fprintf(file, "%s       ", (printed ? "\n" : ""));
+                fprintf(file, " case %d:", c);
+                printed++;
+            }
+            fprintf(file, " goto s%d;\n", row[k]);
+        }
+        fprintf(file, "        default: goto s%d;\n    }\n", fallback);
+    }
+    fprintf(file, "}\n\n");
+    free(hits);
+}
+
+// Byte to class map, then a dense table with one column per class for each DFA state (left
+// out for the goto runner, which has the transitions in its code) and the accept flags
+void dfaTablesCode(FILE *file, int withTable) {
+    const char *cell = dfaCellType(dfaCount);
+    if (withTable) {
+        fprintf(file, "static const unsigned char dfa_class[256] = {");
+        for (int c = 0; c < 256; c++)
+            fprintf(file, "%d%s", byteClass[c], (c + 1 < 256 ? "," : ""));
+        fprintf(file, "};\n\n");
+
+        fprintf(file, "static const %s dfa_table[%d][%d] = {\n", cell, dfaCount, classCount);
+        for (int d = 0; d < dfaCount; d++) {
+            fprintf(file, "    {");
+            for (int c = 0; c < classCount; c++)
+                fprintf(file, "%d%s", dfaTable[d * classCount + c], (c + 1 < classCount ? "," : ""));
+            fprintf(file, "}%s\n", (d + 1 < dfaCount ? "," : ""));
+        }
+        fprintf(file, "};\n\n");
+
+    }
+    int values = 2; // accept flags, or accept set ids with --set
+    for (int d = 0; d < dfaCount; d++) if (dfaAccept[d] >= values) values = dfaAccept[d] + 1;
+    fprintf(file, "static const %s dfa_accept[%d] = {", dfaCellType(values), dfaCount);
+    for (int d = 0; d < dfaCount; d++)
+        fprintf(file, "%d%s", dfaAccept[d], (d + 1 < dfaCount ? "," : ""));
+    fprintf(file, "};\n\n");
+}
+
+// Data parallel matching of one large input for the table DFA (rexec -j N). The input is cut
+// into one chunk per thread. The first chunk runs from the start state; every other chunk runs
+// from all states at once and records where each of them ends up, the lanes that reach the same
+// state being merged as they go (a DFA tends to forget where it started within a few hundred
+// bytes, Mytkowicz et al.). Composing those maps in order gives the exact final state. Lanes
+// cost one scan each, so a chunk whose lanes have not merged down to a few after a probe is
+// left to the sequential scan, as are all chunks of a DFA with too many states to start from.
+void parallelCode(FILE *file) {
+    fprintf(file,
+        "#include <pthread.h>\n"
+        "#include <sys/mman.h>\n"
+        "#include <sys/stat.h>\n\n"
+        "#define PARALLEL_SCAN // -j N also splits one large file\n"
+        "#define NUM_STATES %d\n"
+        "#define MAX_THREADS 256\n"
+        "#ifndef PARALLEL_MIN\n"
+        "#define PARALLEL_MIN (1 << 22) // smaller files are scanned by one thread\n"
+        "#endif\n"
+        "#define LANE_BLOCK 1024 // bytes every lane advances between two merges\n"
+        "#define MAX_LANES 256 // more states than this are not worth a lane each\n"
+        "#define LANE_PROBE (1 << 16) // bytes after which the lanes must have merged down to\n"
+        "#define LANE_LIMIT 4 // this many, or the chunk is scanned sequentially instead\n\n"
+        "int threads = 1;\n\n"
+
+        "typedef struct Chunk {\n"
+        "    const unsigned char *input;\n"
+        "    long len;\n"
+        "    int *map; // state reached at the end of the chunk from each state at its start\n"
+        "    int given_up; // no map, the chunk has to be scanned from the state reached before it\n"
+        "} Chunk;\n\n"
+
+        "void *scan_chunk(void *arg) {\n"
+        "    Chunk *c = (Chunk *)arg;\n"
+        "    int *lane = malloc(NUM_STATES * sizeof(int)); // current state of each lane\n"
+        "    int *merged = malloc(NUM_STATES * sizeof(int)); // lane already in a state, or -1\n"
+        "    int *remap = malloc(NUM_STATES * sizeof(int)); // new index of each lane\n"
+        "    int lanes = NUM_STATES;\n"
+        "    c->given_up = !lane || !merged || !remap || !c->map;\n"
+        "    for (int s = 0; s < NUM_STATES && !c->given_up; s++) { lane[s] = s; c->map[s] = s; merged[s] = -1; }\n"
+        "    long i = 0;\n"
+        "    while (!c->given_up && i < c->len && lanes > 1) {\n"
+        "        long end = c->len - i < LANE_BLOCK ? c->len : i + LANE_BLOCK;\n"
+        "        for (int l = 0; l < lanes; l++) {\n"
+        "            int state = lane[l];\n"
+        "            for (long k = i; k < end; k++) state = dfa_table[state][dfa_class[c->input[k]]];\n"
+        "            lane[l] = state;\n"
+        "        }\n"
+        "        i = end;\n"
+        "        int n = 0;\n"
+        "        for (int l = 0; l < lanes; l++) {\n"
+        "            if (merged[lane[l]] < 0) { merged[lane[l]] = n; lane[n++] = lane[l]; }\n"
+        "            remap[l] = merged[lane[l]];\n"
+        "        }\n"
+        "        for (int l = 0; l < n; l++) merged[lane[l]] = -1;\n"
+        "        if (n < lanes)\n"
+        "            for (int s = 0; s < NUM_STATES; s++) c->map[s] = remap[c->map[s]];\n"
+        "        lanes = n;\n"
+        "        if (i >= LANE_PROBE && lanes > LANE_LIMIT) c->given_up = 1; // slower than one scan\n"
+        "    }\n"
+        "    if (!c->given_up) {\n"
+        "        if (lanes == 1) lane[0] = scan(c->input + i, c->len - i, lane[0]); // all converged\n"
+        "        for (int s = 0; s < NUM_STATES; s++) c->map[s] = lane[c->map[s]];\n"
+        "    }\n"
+        "    free(lane);\n"
+        "    free(merged);\n"
+        "    free(remap);\n"
+        "    return NULL;\n"
+        "}\n\n"
+
+        "int match_parallel(const unsigned char *input, long len) {\n"
+        "    int n = threads < MAX_THREADS ? threads : MAX_THREADS;\n"
+        "    if (NUM_STATES > MAX_LANES) n = 1;\n"
+        "    Chunk chunks[MAX_THREADS] = {{0}};\n"
+        "    pthread_t tid[MAX_THREADS];\n"
+        "    int started[MAX_THREADS] = {0};\n"
+        "    long size = len / n;\n"
+        "    for (int k = 0; k < n; k++) {\n"
+        "        chunks[k].input = input + k * size;\n"
+        "        chunks[k].len = k + 1 < n ? size : len - k * size;\n"
+        "        if (k == 0) continue;\n"
+        "        chunks[k].map = malloc(NUM_STATES * sizeof(int));\n"
+        "        started[k] = pthread_create(&tid[k], NULL, scan_chunk, &chunks[k]) == 0;\n"
+        "        if (!started[k]) chunks[k].given_up = 1; // no thread left, scanned in order below\n"
+        "    }\n"
+        "    int state = scan(chunks[0].input, chunks[0].len, START_STATE);\n"
+        "    for (int k = 1; k < n; k++) {\n"
+        "        if (started[k]) pthread_join(tid[k], NULL);\n"
+        "        if (state < SETTLED) continue;\n"
+        "        state = chunks[k].given_up ? scan(chunks[k].input, chunks[k].len, state) : chunks[k].map[state];\n"
+        "    }\n"
+        "    for (int k = 1; k < n; k++) free(chunks[k].map);\n"
+        "    return dfa_accept[state];\n"
+        "}\n\n",
+        dfaCount
+    );
+}
+
+// Determinize, minimize and number the settled states first
+void prepareDfa() {
+    buildDfa();
+    int before = dfaCount;
+    minimizeDfa();
+    orderTerminals();
+    if (dfaStats) {
+        printf("DFA states: %d before minimization, %d after\n", before, dfaCount);
+        printf("Settled states: %d\n", terminalCount);
+        printf("Byte classes: %d\n", classCount);
+    }
+}
+
+void dfaCode(FILE *file) {
+    prepareDfa();
+    fprintf(file,
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n\n"
+    );
+
+    // 1) Class map and transition table, then the accept flags
+    dfaTablesCode(file, genMode == GEN_DFA);
+
+    // 2) One start state, & and ! are already folded into dfa_accept
+    fprintf(file, "#define START_STATE %d\n", dfaStart);
+    fprintf(file, "#define SETTLED %d // states below this id are dead or accept everything\n", terminalCount);
+    fprintf(file, "#define REENTRANT_MATCH // scan() only reads the tables\n\n");
+
+    // 3) DFA runner: one table lookup per byte, or one labeled block per state
+    if (genMode == GEN_GOTO) {
+        gotoCode(file);
+    }
+    else {
+        fprintf(file,
+            "// advance from state over one chunk and return the state reached\n"
+            "int scan(const unsigned char *input, long len, int state) {\n"
+            "    for (long i = 0; i < len && state >= SETTLED; ++i)\n"
+            "        state = dfa_table[state][dfa_class[input[i]]];\n"
+            "    return state;\n"
+            "}\n\n"
+        );
+        parallelCode(file);
+    }
+
+    // 4) stream the file (or stdin) in fixed size chunks in a single pass, carrying the state across them
+    fprintf(file,
+        "#define CHUNK_SIZE 65536 // bytes read from the input at a time\n\n"
+        "int match_stream(FILE *f) {\n"
+        "    static unsigned char buf[CHUNK_SIZE];\n"
+        "    int state = START_STATE;\n"
+        "    size_t n;\n"
+        "%s"
+        "    while (state >= SETTLED && (n = fread(buf, 1, CHUNK_SIZE, f)) > 0) state = scan(buf, n, state);\n"
+        "    return dfa_accept[state]; // stops reading once the verdict is settled\n"
+        "}\n\n"
+
+        "int match_record(const unsigned char *input, long len) {\n"
+        "    return dfa_accept[scan(input, len, START_STATE)];\n"
+        "}\n\n",
+        genMode == GEN_DFA ?
+        "    struct stat st; // with -j, a large regular file is mapped and split between threads\n"
+        "    if (threads > 1 && fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= PARALLEL_MIN) {\n"
+        "        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);\n"
+        "        if (p != MAP_FAILED) {\n"
+        "            int m = match_parallel(p, st.st_size);\n"
+        "            munmap(p, st.st_size);\n"
+        "            return m;\n"
+        "        }\n"
+        "    }\n" : ""
+    );
+    mainCode(file, 0);
+    freeDfa();
+}
+
+// n as 4 little endian bytes, whatever the byte order of this host
+void putLe32(FILE *file, uint32_t n) {
+    for (int k = 0; k < 4; k++) fputc(n >> 8 * k & 0xff, file);
+}
+
+// Write the minimized DFA as a binary automaton file (--save) for the generic runner. Every
+// field is written on its own, so the file is the same on any host and has no padding holes
+void saveAutomaton(FILE *file) {
+    prepareDfa();
+    fwrite(AUTOMATON_MAGIC, 1, 8, file);
+    uint32_t fields[] = { AUTOMATON_VERSION, dfaCount, classCount, dfaStart, terminalCount, 0 };
+    for (int k = 0; k < 6; k++) putLe32(file, fields[k]); // version up to reserved, in header order
+    for (int c = 0; c < 256; c++) fputc(byteClass[c], file);
+    for (int d = 0; d < dfaCount; d++)
+        for (int k = 0; k < classCount; k++) putLe32(file, dfaTable[d * classCount + k]);
+    for (int d = 0; d < dfaCount; d++) fputc(dfaAccept[d] ? 1 : 0, file);
+    freeDfa();
+}
@@ -0,0 +1,232 @@
+/*
+    Input handling shared by every rexec.c and the generic runner (runner/runner.c includes the
+    copy written by generate --driver): options, records, files and directories, the thread pool
+    and the totals. It only talks to the matcher through
+
+        VERDICT_BYTES                          size of what one input gives
+        match_input(FILE *f, v)                verdict of the whole input read from f
+        match_buffer(input, len, v)            verdict of one input or record already in memory
+        report(path, v, counts)                print one verdict (no path: no prefix) and count it
+        totals(counts, files)                  print the totals once every input is done
+
+    and REENTRANT_MATCH, defined when match_buffer() may run on several threads at once.
+    verdictCode() writes them for a single pattern, lib/Set.h for a set.
+*/
+
+// match_input/match_buffer/report/totals for a single pattern on top of the backend's
+// match_stream(FILE *) and match_record(buf, len), behind the prefilter when there is one
+void verdictCode(FILE *file, int filtered) {
+    fprintf(file,
+        "#define VERDICT_BYTES 1\n\n"
+
+        "void match_input(FILE *f, unsigned char *v) {\n"
+        "    v[0] = %smatch_stream(f);\n"
+        "}\n\n"
+
+        "void match_buffer(const unsigned char *input, long len, unsigned char *v) {\n"
+        "    v[0] = %smatch_record(input, len);\n"
+        "}\n\n"
+
+        "long accepted = 0, rejected = 0;\n\n"
+
+        "void report(const char *path, const unsigned char *v, int counts) {\n"
+        "    if (v[0]) accepted++; else rejected++;\n"
+        "    if (counts) return;\n"
+        "    if (path) printf(\"%%s: \", path);\n"
+        "    fputs(v[0] ? \"ACCEPTS\\n\" : \"REJECTS\\n\", stdout);\n"
+        "}\n\n"
+
+        "// with -c, and after several files\n"
+        "void totals(int counts, int files) {\n"
+        "    if (counts || files) printf(\"ACCEPTS %%ld\\nREJECTS %%ld\\n\", accepted, rejected);\n"
+        "}\n\n",
+        filtered ? "prefilter_file(f) && " : "",
+        filtered ? "prefilter(input, len) && " : ""
+    );
+}
+
+// run_inputs(argc, argv) does everything main() does after the matcher is set up
+void driverCode(FILE *file) {
+    fprintf(file,
+        "#include <dirent.h>\n"
+        "#include <fcntl.h>\n"
+        "#include <pthread.h>\n"
+        "#include <unistd.h>\n"
+        "#include <sys/mman.h>\n"
+        "#include <sys/stat.h>\n\n"
+        "#ifndef PARALLEL_SCAN\n"
+        "int threads = 1; // -j N\n"
+        "#endif\n\n"
+
+        "// rexec gives up when memory runs out\n"
+        "void *must_realloc(void *p, size_t size) {\n"
+        "    p = realloc(p, size ? size : 1);\n"
+        "    if (!p) { perror(\"realloc\"); exit(1); }\n"
+        "    return p;\n"
+        "}\n\n"
+
+        "// next record of f into *rec, grown as needed; returns its length or -1 at end of input\n"
+        "// mode 'r': newline terminated, mode 'l': 4 byte little endian length then the bytes\n"
+        "long read_record(FILE *f, int mode, unsigned char **rec, size_t *cap) {\n"
+        "    if (mode == 'l') {\n"
+        "        unsigned char h[4];\n"
+        "        if (fread(h, 1, 4, f) != 4) return -1;\n"
+        "        size_t len = h[0] | h[1] << 8 | h[2] << 16 | (size_t)h[3] << 24;\n"
+        "        if (len + 1 > *cap) { *cap = len + 1; *rec = must_realloc(*rec, *cap); }\n"
+        "        if (fread(*rec, 1, len, f) != len) return -1;\n"
+        "        return len;\n"
+        "    }\n"
+        "    long len = getdelim((char **)rec, cap, '\\n', f);\n"
+        "    if (len > 0 && (*rec)[len - 1] == '\\n') len--;\n"
+        "    return len;\n"
+        "}\n\n"
+    );
+
+    // inputs given on the command line, directories expanded, and the pool that matches them
+    fprintf(file,
+        "char **inputs = NULL;\n"
+        "int input_count = 0, input_cap = 0;\n"
+        "unsigned char *verdicts = NULL; // VERDICT_BYTES for each input\n"
+        "signed char *unreadable = NULL; // 1 for the inputs that could not be read\n"
+        "int next_input = 0; // next file a worker takes, shared by all of them\n\n"
+
+        "// Paths given on the command line are followed wherever they point. Inside a directory\n"
+        "// symbolic links to directories are skipped, so a link back up cannot loop forever\n"
+        "void add_input(const char *path, int *listed, int top) {\n"
+        "    struct stat st;\n"
+        "    int special = strcmp(path, \"-\") == 0 || (top ? stat(path, &st) : lstat(path, &st)) != 0;\n"
+        "    if (!special && S_ISLNK(st.st_mode) && (stat(path, &st) != 0 || S_ISDIR(st.st_mode))) return;\n"
+        "    DIR *d = !special && S_ISDIR(st.st_mode) ? opendir(path) : NULL;\n"
+        "    if (d == NULL) {\n"
+        "        if (input_count == input_cap) {\n"
+        "            input_cap = input_cap ? input_cap * 2 : 64;\n"
+        "            inputs = must_realloc(inputs, input_cap * sizeof(char *));\n"
+        "        }\n"
+        "        inputs[input_count] = must_realloc(NULL, strlen(path) + 1);\n"
+        "        strcpy(inputs[input_count++], path);\n"
+        "        return;\n"
+        "    }\n"
+        "    *listed = 1;\n"
+        "    struct dirent *e;\n"
+        "    while ((e = readdir(d)) != NULL) {\n"
+        "        if (strcmp(e->d_name, \".\") == 0 || strcmp(e->d_name, \"..\") == 0) continue;\n"
+        "        char *child = must_realloc(NULL, strlen(path) + strlen(e->d_name) + 2);\n"
+        "        sprintf(child, \"%%s/%%s\", path, e->d_name);\n"
+        "        add_input(child, listed, 0);\n"
+        "        free(child);\n"
+        "    }\n"
+        "    closedir(d);\n"
+        "}\n\n"
+
+        "// verdict for one whole file into v; -1 when it cannot be read. Regular files are mapped\n"
+        "// and read in place, anything else is read into memory first\n"
+        "int match_file(const char *path, unsigned char *v) {\n"
+        "    int fd = strcmp(path, \"-\") == 0 ? 0 : open(path, O_RDONLY);\n"
+        "    struct stat st;\n"
+        "    if (fd < 0 || fstat(fd, &st) != 0) { perror(path); return -1; }\n"
+        "    if (S_ISREG(st.st_mode) && st.st_size > 0) {\n"
+        "        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);\n"
+        "        if (p != MAP_FAILED) {\n"
+        "            madvise(p, st.st_size, MADV_SEQUENTIAL);\n"
+        "            match_buffer(p, st.st_size, v);\n"
+        "            munmap(p, st.st_size);\n"
+        "            close(fd);\n"
+        "            return 0;\n"
+        "        }\n"
+        "    }\n"
+        "    unsigned char *buf = NULL;\n"
+        "    size_t len = 0, cap = 0;\n"
+        "    ssize_t n;\n"
+        "    do {\n"
+        "        if (len == cap) { cap = cap ? cap * 2 : 65536; buf = must_realloc(buf, cap); }\n"
+        "        n = read(fd, buf + len, cap - len);\n"
+        "        if (n > 0) len += n;\n"
+        "    } while (n > 0);\n"
+        "    if (n < 0) perror(path);\n"
+        "    else match_buffer(buf, len, v);\n"
+        "    free(buf);\n"
+        "    close(fd);\n"
+        "    return n < 0 ? -1 : 0;\n"
+        "}\n\n"
+
+        "// workers take the next unmatched file until none is left, so a big file only holds up\n"
+        "// the thread matching it\n"
+        "void *match_inputs(void *arg) {\n"
+        "    (void)arg;\n"
+        "    int k;\n"
+        "    while ((k = __atomic_fetch_add(&next_input, 1, __ATOMIC_RELAXED)) < input_count)\n"
+        "        unreadable[k] = match_file(inputs[k], verdicts + (long)k * VERDICT_BYTES) < 0;\n"
+        "    return NULL;\n"
+        "}\n\n"
+    );
+
+    fprintf(file,
+        "// options and inputs of argv; returns the exit status\n"
+        "int run_inputs(int argc, char **argv) {\n"
+        "    int records = 0, counts = 0; // -r / -l split the input into records, -c prints totals only\n"
+        "    int listed = 0; // a directory was given\n"
+        "    for (int a = 1; a < argc; a++) {\n"
+        "        if (strcmp(argv[a], \"-r\") == 0) records = 'r';\n"
+        "        else if (strcmp(argv[a], \"-l\") == 0) records = 'l';\n"
+        "        else if (strcmp(argv[a], \"-c\") == 0) counts = 1;\n"
+        "        else if (strcmp(argv[a], \"-j\") == 0 && a + 1 < argc) threads = atoi(argv[++a]);\n"
+        "        else add_input(argv[a], &listed, 1);\n"
+        "    }\n"
+        "    if (input_count == 0 && !listed) add_input(\"-\", &listed, 1);\n"
+        "    unsigned char v[VERDICT_BYTES];\n"
+        "    int failed = 0;\n"
+        "    if (records) {\n"
+        "        // one verdict per record, reusing the automaton and the record buffer\n"
+        "        unsigned char *rec = NULL;\n"
+        "        size_t cap = 0;\n"
+        "        for (int k = 0; k < input_count; k++) {\n"
+        "            FILE *f = strcmp(inputs[k], \"-\") == 0 ? stdin : fopen(inputs[k], \"rb\");\n"
+        "            if (!f) { perror(inputs[k]); failed = 1; continue; }\n"
+        "            long len;\n"
+        "            while ((len = read_record(f, records, &rec, &cap)) >= 0) {\n"
+        "                match_buffer(rec, len, v);\n"
+        "                report(NULL, v, counts);\n"
+        "            }\n"
+        "            if (f != stdin) fclose(f);\n"
+        "        }\n"
+        "        totals(counts, 0);\n"
+        "        free(rec);\n"
+        "    }\n"
+        "    else if (input_count == 1 && !listed) {\n"
+        "        // a single input is streamed in constant memory\n"
+        "        FILE *f = strcmp(inputs[0], \"-\") == 0 ? stdin : fopen(inputs[0], \"rb\");\n"
+        "        if (!f) { perror(inputs[0]); return 1; }\n"
+        "        match_input(f, v);\n"
+        "        report(NULL, v, counts);\n"
+        "        totals(counts, 0);\n"
+        "        if (f != stdin) fclose(f);\n"
+        "    }\n"
+        "    else {\n"
+        "        // many files: one verdict each, then the totals\n"
+        "        verdicts = must_realloc(NULL, ((long)input_count + 1) * VERDICT_BYTES);\n"
+        "        unreadable = must_realloc(NULL, input_count + 1);\n"
+        "#ifdef REENTRANT_MATCH\n"
+        "        int n = threads < 1 ? 1 : threads > input_count ? input_count : threads;\n"
+        "#else\n"
+        "        int n = 1; // match_buffer() shares its state between calls\n"
+        "#endif\n"
+        "        pthread_t *tid = must_realloc(NULL, (n + 1) * sizeof(pthread_t));\n"
+        "        int started = 1;\n"
+        "        while (started < n && pthread_create(&tid[started], NULL, match_inputs, NULL) == 0) started++;\n"
+        "        match_inputs(NULL);\n"
+        "        for (int k = 1; k < started; k++) pthread_join(tid[k], NULL);\n"
+        "        for (int k = 0; k < input_count; k++) {\n"
+        "            if (unreadable[k]) { failed = 1; continue; }\n"
+        "            report(inputs[k], verdicts + (long)k * VERDICT_BYTES, counts);\n"
+        "        }\n"
+        "        totals(counts, 1);\n"
+        "        free(tid);\n"
+        "        free(verdicts);\n"
+        "        free(unreadable);\n"
+        "    }\n"
+        "    for (int k = 0; k < input_count; k++) free(inputs[k]);\n"
+        "    free(inputs);\n"
+        "    return failed;\n"
+        "}\n"
+    );
+}
@@ -0,0 +1,350 @@
+/*
+    Lazy DFA backend. Instead of determinizing ahead of time, the lowered NFA from DFA.h is
+    emitted as compact tables and rexec.c builds DFA states on demand while it reads the input.
+    States live in a hash table bounded by a memory budget; when the budget runs out the cache
+    is flushed, and when flushes come faster than the states get reused the matcher falls back
+    to plain NFA simulation. Patterns whose full DFA would never fit still scan at DFA speed.
+    Like DFA.h, the sub regexes of & and ! share one set of NFA states and one pass.
+*/
+
+long lazyCacheBudget = 1 << 20; // bytes of cached DFA states before a flush, set by --cache=
+
+// A byte state only matters inside a set if it consumes input or accepts
+int lazyImportant(int s) {
+    return byteStates[s].edges != NULL || byteStates[s].is_accept;
+}
+
+#define LAZY_UNIVERSAL_LIMIT 64 // sets explored before a state is assumed not universal
+
+// The sub regex owning s accepts every continuation once s is in the set: each set reachable from
+// the closure of s holds the accept state of that sub. Only small neighbourhoods are explored.
+int lazyUniversal(int s, int *seed, int *set) {
+    int k = ownerSub[s];
+    if (k < 0) return 0;
+    int accept = startStates[k]->pair->id;
+    int *sets[LAZY_UNIVERSAL_LIMIT], sizes[LAZY_UNIVERSAL_LIMIT];
+    int count = 0, universal = 1;
+    sizes[count] = epsilonClosure(&s, 1, set);
+    sets[count] = (int *)malloc((sizes[count] + 1) * sizeof(int));
+    memcpy(sets[count], set, sizes[count] * sizeof(int));
+    count++;
+    for (int i = 0; i < count && universal; i++) {
+        int found = 0;
+        for (int j = 0; j < sizes[i] && !found; j++) found = sets[i][j] == accept;
+        if (!found) { universal = 0; break; }
+        for (int c = 0; c < classCount && universal; c++) {
+            int seedCount = 0;
+            moveStamp++;
+            for (int j = 0; j < sizes[i]; j++) {
+                for (ByteEdge *e = byteStates[sets[i][j]].edges; e; e = e->next) {
+                    if (BIT_TEST(e->set, classRep[c]) && moveMark[e->to] != moveStamp) {
+                        moveMark[e->to] = moveStamp;
+                        seed[seedCount++] = e->to;
+                    }
+                }
+            }
+            int n = seedCount ? epsilonClosure(seed, seedCount, set) : 0;
+            int known = 0;
+            for (int j = 0; j < count && !known; j++)
+                known = sizes[j] == n && memcmp(sets[j], set, n * sizeof(int)) == 0;
+            if (known) continue;
+            if (count == LAZY_UNIVERSAL_LIMIT) { universal = 0; break; }
+            sizes[count] = n;
+            sets[count] = (int *)malloc((n + 1) * sizeof(int));
+            memcpy(sets[count], set, n * sizeof(int));
+            count++;
+        }
+    }
+    for (int i = 0; i < count; i++) free(sets[i]);
+    return universal;
+}
+
+void lazyCode(FILE *file) {
+    prepareLowered();
+    int *set = (int *)malloc(byteCount * sizeof(int));
+    int classBytes = (classCount + 7) / 8;
+    if (dfaStats) {
+        printf("Lazy DFA: %d NFA states\n", byteCount);
+        printf("Byte classes: %d\n", classCount);
+    }
+
+    fprintf(file,
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n\n"
+    );
+    fprintf(file, "#define NUM_NFA %d // lowered NFA states\n", byteCount);
+    fprintf(file, "#define NUM_CLASSES %d // byte equivalence classes\n", classCount);
+    fprintf(file, "#ifndef CACHE_BUDGET\n#define CACHE_BUDGET %ldL // bytes of DFA states kept before a flush\n#endif\n", lazyCacheBudget);
+    fprintf(file, "#define HASH_SIZE 4096\n\n");
+
+    // 1) Byte to class map, then the sub regex each accepting NFA state belongs to (plus one),
+    // the sub regex owning each state and the states after which that sub accepts everything
+    fprintf(file, "static const unsigned char nfa_class[256] = {");
+    for (int c = 0; c < 256; c++)
+        fprintf(file, "%d%s", byteClass[c], (c + 1 < 256 ? "," : ""));
+    fprintf(file, "};\n\n");
+    const char *subCell = dfaCellType(startCount + 1); // sub numbers plus one, or 0
+    fprintf(file, "static const %s nfa_sub[NUM_NFA] = {", subCell);
+    for (int s = 0; s < byteCount; s++)
+        fprintf(file, "%d%s", acceptSub[s] + 1, (s + 1 < byteCount ? "," : ""));
+    fprintf(file, "};\n");
+    fprintf(file, "static const %s nfa_owner[NUM_NFA] = {", subCell);
+    for (int s = 0; s < byteCount; s++)
+        fprintf(file, "%d%s", ownerSub[s] < 0 ? 0 : ownerSub[s], (s + 1 < byteCount ? "," : ""));
+    fprintf(file, "};\n");
+    int *seed = (int *)malloc(byteCount * sizeof(int));
+    fprintf(file, "static const unsigned char nfa_universal[NUM_NFA] = {");
+    for (int s = 0; s < byteCount; s++)
+        fprintf(file, "%d%s", lazyImportant(s) && lazyUniversal(s, seed, set), (s + 1 < byteCount ? "," : ""));
+    fprintf(file, "};\n\n");
+
+    // 2) Sorted epsilon closure of every NFA state, keeping only the states that matter
+    int total = 0;
+    fprintf(file, "static const int closure_start[NUM_NFA + 1] = {0");
+    for (int s = 0; s < byteCount; s++) {
+        int n = epsilonClosure(&s, 1, set);
+        for (int i = 0; i < n; i++) total += lazyImportant(set[i]);
+        fprintf(file, ",%d", total);
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "static const int closure_list[%d] = {", total + 1);
+    for (int s = 0; s < byteCount; s++) {
+        int n = epsilonClosure(&s, 1, set);
+        for (int i = 0; i < n; i++)
+            if (lazyImportant(set[i])) fprintf(file, "%d,", set[i]);
+    }
+    fprintf(file, "-1};\n\n");
+
+    // 3) Outgoing edges of every NFA state as a target plus the set of classes it accepts
+    total = 0;
+    fprintf(file, "static const int edge_start[NUM_NFA + 1] = {0");
+    for (int s = 0; s < byteCount; s++) {
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next) total++;
+        fprintf(file, ",%d", total);
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "static const int edge_to[%d] = {", total + 1);
+    for (int s = 0; s < byteCount; s++)
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next) fprintf(file, "%d,", e->to);
+    fprintf(file, "-1};\n");
+    fprintf(file, "static const unsigned char edge_set[%d][%d] = {\n", total + 1, classBytes);
+    for (int s = 0; s < byteCount; s++) {
+        for (ByteEdge *e = byteStates[s].edges; e; e = e->next) {
+            unsigned char bits[32] = {0};
+            for (int c = 0; c < 256; c++)
+                if (BIT_TEST(e->set, c)) BIT_SET(bits, byteClass[c]);
+            fprintf(file, "    {");
+            for (int k = 0; k < classBytes; k++) fprintf(file, "%d%s", bits[k], (k + 1 < classBytes ? "," : ""));
+            fprintf(file, "},\n");
+        }
+    }
+    fprintf(file, "    {0}\n};\n\n");
+
+    // 4) Start set holding every sub regex, and the invert flag of each one for the product accept
+    int n = startClosure(seed, set), startSize = 0;
+    fprintf(file, "static const int start_set[] = {");
+    for (int i = 0; i < n; i++)
+        if (lazyImportant(set[i])) fprintf(file, "%s%d", (startSize++ ? "," : ""), set[i]);
+    fprintf(file, "%s-1};\n#define START_SIZE %d\n", (startSize ? "," : ""), startSize);
+    fprintf(file, "#define SUBS %d\n", startCount);
+    fprintf(file, "static const unsigned char invert[SUBS] = {");
+    for (int i = 0; i < startCount; i++)
+        fprintf(file, "%d%s", invertFlags[i], (i + 1 < startCount ? ", " : ""));
+    fprintf(file, "};\n\n");
+    free(seed);
+
+    // 5) State cache: DFA states keyed by their NFA set, transitions filled in on first use
+    fprintf(file,
+        "typedef struct DState {\n"
+        "    struct DState *next[NUM_CLASSES]; // NULL until the transition is computed\n"
+        "    struct DState *chain; // hash bucket\n"
+        "    struct DState *older; // every cached state, newest first\n"
+        "    int accept;\n"
+        "    int settled; // dead or accepting everything, the verdict can no longer change\n"
+        "    int size;\n"
+        "    int set[]; // sorted NFA states\n"
+        "} DState;\n\n"
+
+        "static DState *buckets[HASH_SIZE];\n"
+        "static DState *newest = NULL;\n"
+        "static long cache_used = 0; // bytes held by cached states\n"
+        "static long built = 0; // states built since the last flush\n"
+        "static long scanned = 0; // bytes scanned since the last flush\n"
+        "static int epoch = 0; // bumped by every flush, cached pointers from before are gone\n"
+        "static int flushing = 0;\n"
+        "static int use_nfa = 0; // the cache thrashes, simulate the NFA instead\n"
+        "static DState *current = NULL;\n"
+        "static int sim_set[NUM_NFA]; // NFA set once use_nfa is on, also saves the current set across a flush\n"
+        "static int sim_size = 0;\n"
+        "static int scratch[NUM_NFA], mark[NUM_NFA], stamp = 0;\n\n"
+    );
+    fprintf(file,
+        "static int int_compare(const void *a, const void *b) {\n"
+        "    int x = *(const int *)a, y = *(const int *)b;\n"
+        "    return (x > y) - (x < y);\n"
+        "}\n\n"
+
+        "static unsigned hash_set(const int *set, int n) {\n"
+        "    unsigned h = 2166136261u; // FNV-1a\n"
+        "    for (int i = 0; i < n; i++) { h ^= (unsigned)set[i]; h *= 16777619u; }\n"
+        "    return h %% HASH_SIZE;\n"
+        "}\n\n"
+
+        "// every sub regex accepts, or does not for the inverted ones of !\n"
+        "static int set_accepts(const int *set, int n) {\n"
+        "    unsigned char hit[SUBS] = {0};\n"
+        "    for (int i = 0; i < n; i++) if (nfa_sub[set[i]]) hit[nfa_sub[set[i]] - 1] = 1;\n"
+        "    for (int k = 0; k < SUBS; k++) if (hit[k] == invert[k]) return 0;\n"
+        "    return 1;\n"
+        "}\n\n"
+
+        "// a sub regex is settled once its states are gone (it rejects from now on) or one of them is\n"
+        "// universal (it accepts); the verdict is fixed when one settled sub fails the & or all are settled\n"
+        "static int set_settled(const int *set, int n) {\n"
+        "    unsigned char live[SUBS] = {0}, sure[SUBS] = {0};\n"
+        "    int open = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        live[nfa_owner[set[i]]] = 1;\n"
+        "        if (nfa_universal[set[i]]) sure[nfa_owner[set[i]]] = 1;\n"
+        "    }\n"
+        "    for (int k = 0; k < SUBS; k++) {\n"
+        "        if (live[k] && !sure[k]) { open = 1; continue; }\n"
+        "        if (live[k] == invert[k]) return 1;\n"
+        "    }\n"
+        "    return !open;\n"
+        "}\n\n"
+
+        "static DState *lookup(const int *set, int n);\n\n"
+
+        "// drop every cached state but the current one\n"
+        "static void flush_cache(void) {\n"
+        "    flushing = 1;\n"
+        "    sim_size = current ? current->size : 0;\n"
+        "    if (current) memcpy(sim_set, current->set, sim_size * sizeof(int));\n"
+        "    for (DState *d = newest, *o; d; d = o) { o = d->older; free(d); }\n"
+        "    newest = NULL;\n"
+        "    memset(buckets, 0, sizeof(buckets));\n"
+        "    if (scanned < 10 * built) use_nfa = 1; // states are not reused, caching does not pay off\n"
+        "    cache_used = built = scanned = 0;\n"
+        "    epoch++;\n"
+        "    if (current && !use_nfa) current = lookup(sim_set, sim_size);\n"
+        "    if (cache_used > CACHE_BUDGET) use_nfa = 1; // not even the live states fit\n"
+        "    flushing = 0;\n"
+        "}\n\n"
+
+        "// find the DFA state for a sorted NFA set, building it when new; NULL once use_nfa is on\n"
+        "static DState *lookup(const int *set, int n) {\n"
+        "    unsigned h = hash_set(set, n);\n"
+        "    for (DState *d = buckets[h]; d; d = d->chain)\n"
+        "        if (d->size == n && memcmp(d->set, set, n * sizeof(int)) == 0) return d;\n"
+        "    long size = sizeof(DState) + n * sizeof(int);\n"
+        "    if (!flushing && cache_used + size > CACHE_BUDGET) {\n"
+        "        flush_cache();\n"
+        "        if (use_nfa) return NULL;\n"
+        "    }\n"
+        "    DState *d = calloc(1, size);\n"
+        "    if (!d) { perror(\"calloc\"); exit(1); }\n"
+        "    memcpy(d->set, set, n * sizeof(int));\n"
+        "    d->size = n;\n"
+        "    d->accept = set_accepts(set, n);\n"
+        "    d->settled = set_settled(set, n);\n"
+        "    d->chain = buckets[h];\n"
+        "    buckets[h] = d;\n"
+        "    d->older = newest;\n"
+        "    newest = d;\n"
+        "    cache_used += size;\n"
+        "    built++;\n"
+        "    return d;\n"
+        "}\n\n"
+
+        "// NFA states reached from set on class k, sorted, written to out\n"
+        "static int move(const int *set, int n, int k, int *out) {\n"
+        "    int count = 0;\n"
+        "    stamp++;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        for (int e = edge_start[set[i]]; e < edge_start[set[i] + 1]; e++) {\n"
+        "            if (!(edge_set[e][k >> 3] & (1 << (k & 7)))) continue;\n"
+        "            for (int c = closure_start[edge_to[e]]; c < closure_start[edge_to[e] + 1]; c++) {\n"
+        "                int t = closure_list[c];\n"
+        "                if (mark[t] != stamp) { mark[t] = stamp; out[count++] = t; }\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    qsort(out, count, sizeof(int), int_compare);\n"
+        "    return count;\n"
+        "}\n\n"
+
+        "// slow path: build the transition of d on class k and remember it\n"
+        "static DState *step_state(DState *d, int k) {\n"
+        "    int n = move(d->set, d->size, k, scratch);\n"
+        "    int before = epoch;\n"
+        "    DState *next = lookup(scratch, n);\n"
+        "    if (next && epoch == before) d->next[k] = next; // d is gone if the cache was flushed\n"
+        "    return next;\n"
+        "}\n\n"
+
+        "// fallback once caching stopped paying off: step the NFA set directly\n"
+        "static void simulate(const unsigned char *input, long len) {\n"
+        "    for (long i = 0; i < len && !set_settled(sim_set, sim_size); ++i) {\n"
+        "        int n = move(sim_set, sim_size, nfa_class[input[i]], scratch);\n"
+        "        memcpy(sim_set, scratch, n * sizeof(int));\n"
+        "        sim_size = n;\n"
+        "    }\n"
+        "}\n\n"
+
+        "// advance over one chunk, following cached transitions and building missing ones\n"
+        "void scan(const unsigned char *input, long len) {\n"
+        "    if (use_nfa) { simulate(input, len); return; }\n"
+        "    DState *d = current;\n"
+        "    long last = 0;\n"
+        "    for (long i = 0; i < len && !d->settled; ++i) {\n"
+        "        DState *next = d->next[nfa_class[input[i]]];\n"
+        "        if (!next) {\n"
+        "            scanned += i - last;\n"
+        "            last = i;\n"
+        "            current = d; // a flush keeps the current state alive\n"
+        "            next = step_state(d, nfa_class[input[i]]);\n"
+        "            if (use_nfa) { simulate(input + i, len - i); return; }\n"
+        "        }\n"
+        "        d = next;\n"
+        "    }\n"
+        "    scanned += len - last;\n"
+        "    current = d;\n"
+        "}\n\n"
+
+        "void start(void) {\n"
+        "    if (!use_nfa) current = lookup(start_set, START_SIZE);\n"
+        "    if (use_nfa) { memcpy(sim_set, start_set, START_SIZE * sizeof(int)); sim_size = START_SIZE; }\n"
+        "}\n\n"
+
+        "int is_settled(void) {\n"
+        "    return use_nfa ? set_settled(sim_set, sim_size) : current->settled;\n"
+        "}\n\n"
+
+        "int verdict(void) {\n"
+        "    return use_nfa ? set_accepts(sim_set, sim_size) : current->accept;\n"
+        "}\n\n"
+    );
+
+    // 6) stream the file (or stdin) in fixed size chunks in a single pass, the cache persists across records
+    fprintf(file,
+        "#define CHUNK_SIZE 65536 // bytes read from the input at a time\n\n"
+        "int match_stream(FILE *f) {\n"
+        "    static unsigned char buf[CHUNK_SIZE];\n"
+        "    start();\n"
+        "    size_t n;\n"
+        "    while (!is_settled() && (n = fread(buf, 1, CHUNK_SIZE, f)) > 0) scan(buf, n);\n"
+        "    return verdict();\n"
+        "}\n\n"
+
+        "int match_record(const unsigned char *input, long len) {\n"
+        "    start();\n"
+        "    scan(input, len);\n"
+        "    return verdict();\n"
+        "}\n\n"
+    );
+    mainCode(file, 0);
+    free(set);
+    freeDfa();
+}
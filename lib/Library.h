@@ -0,0 +1,64 @@
+/*
+    Library output (--lib). Instead of a program, rexec.h and rexec.c are written: the minimized
+    DFA lives in static const tables and every call keeps its progress in a rexec_scratch owned
+    by the caller, so any number of threads can match with the same automaton without locks.
+*/
+
+FILE *libHeader = NULL; // rexec.h, opened next to rexec.c by main() for --lib
+
+void libraryCode(FILE *file, FILE *header) {
+    prepareDfa();
+
+    // 1) rexec.h: the scratch type and the API
+    fprintf(header,
+        "#ifndef REXEC_H\n"
+        "#define REXEC_H\n\n"
+        "#include <stddef.h>\n\n"
+        "// Progress of one match, owned by the caller. The automaton itself is read only, so threads\n"
+        "// only need a scratch each.\n"
+        "typedef struct rexec_scratch {\n"
+        "    int state;\n"
+        "} rexec_scratch;\n\n"
+        "// Match a whole buffer; scratch may be NULL\n"
+        "int rexec_match(const void *buf, size_t len, rexec_scratch *scratch);\n\n"
+        "// Match input arriving in pieces: begin, feed every piece in order, then end gives the verdict.\n"
+        "// feed returns 0 once the verdict is settled and the rest of the input can be skipped.\n"
+        "void rexec_begin(rexec_scratch *scratch);\n"
+        "int rexec_feed(rexec_scratch *scratch, const void *buf, size_t len);\n"
+        "int rexec_end(const rexec_scratch *scratch);\n\n"
+        "#endif\n"
+    );
+
+    // 2) rexec.c: the tables, then the functions, which only touch the scratch
+    fprintf(file, "#include \"rexec.h\"\n\n");
+    dfaTablesCode(file, 1);
+    fprintf(file, "#define START_STATE %d\n", dfaStart);
+    fprintf(file, "#define SETTLED %d // states below this id are dead or accept everything\n\n", terminalCount);
+    fprintf(file,
+        "void rexec_begin(rexec_scratch *scratch) {\n"
+        "    scratch->state = START_STATE;\n"
+        "}\n\n"
+
+        "int rexec_feed(rexec_scratch *scratch, const void *buf, size_t len) {\n"
+        "    const unsigned char *input = (const unsigned char *)buf;\n"
+        "    int state = scratch->state;\n"
+        "    for (size_t i = 0; i < len && state >= SETTLED; ++i)\n"
+        "        state = dfa_table[state][dfa_class[input[i]]];\n"
+        "    scratch->state = state;\n"
+        "    return state >= SETTLED;\n"
+        "}\n\n"
+
+        "int rexec_end(const rexec_scratch *scratch) {\n"
+        "    return dfa_accept[scratch->state];\n"
+        "}\n\n"
+
+        "int rexec_match(const void *buf, size_t len, rexec_scratch *scratch) {\n"
+        "    rexec_scratch local;\n"
+        "    if (scratch == NULL) scratch = &local;\n"
+        "    rexec_begin(scratch);\n"
+        "    rexec_feed(scratch, buf, len);\n"
+        "    return rexec_end(scratch);\n"
+        "}\n"
+    );
+    freeDfa();
+}
@@ -0,0 +1,253 @@
+/*
+    Required literal analysis. Walks the AST of the root regex and finds byte strings every
+    accepted input must start with, end with or contain. rexec.c checks them with a vectorized
+    substring search and rejects without running the automaton when one is missing.
+*/
+
+// What is known about the strings a node matches; NULL when nothing is
+typedef struct LiteralInfo {
+    char *exact; // the node only matches this string
+    char *prefix; // every match starts with it
+    char *suffix; // every match ends with it
+    char *inner; // every match contains it
+} LiteralInfo;
+
+char *requiredPrefix = NULL; // factors of the whole pattern found by findLiterals()
+char *requiredSuffix = NULL;
+char *requiredInner = NULL;
+int prefilterEnabled = 1; // cleared by --no-prefilter
+
+char *joinLiterals(const char *a, const char *b) {
+    if (!a || !b) return NULL;
+    char *s = (char *)malloc(strlen(a) + strlen(b) + 1);
+    strcpy(s, a);
+    strcat(s, b);
+    return s;
+}
+
+// keep the longer of two required strings, freeing the other
+char *longerLiteral(char *a, char *b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (strlen(b) > strlen(a)) { free(a); return b; }
+    free(b);
+    return a;
+}
+
+void freeLiteralInfo(LiteralInfo *info) {
+    free(info->exact); free(info->prefix); free(info->suffix); free(info->inner);
+    info->exact = info->prefix = info->suffix = info->inner = NULL;
+}
+
+LiteralInfo exactLiteral(const char *s) {
+    LiteralInfo info;
+    info.exact = strdup(s);
+    info.prefix = strdup(s);
+    info.suffix = strdup(s);
+    info.inner = strdup(s);
+    return info;
+}
+
+LiteralInfo literalInfo(ASTNode *node, Symbol *symbolTable) {
+    LiteralInfo info = { NULL, NULL, NULL, NULL };
+    if (node == NULL) return info;
+
+    // a sequence matches the left part then the right part, so a suffix of the left glued to a
+    // prefix of the right is required too
+    if (node->kind == NODE_SEQ || node->kind == NODE_LITERAL) {
+        LiteralInfo l = literalInfo(node->left, symbolTable);
+        LiteralInfo r = literalInfo(node->right, symbolTable);
+        if (l.exact && r.exact) {
+            char *s = joinLiterals(l.exact, r.exact);
+            info = exactLiteral(s);
+            free(s);
+        }
+        else {
+            info.prefix = l.exact ? joinLiterals(l.exact, r.prefix) : NULL;
+            if (!info.prefix && l.prefix) info.prefix = strdup(l.prefix);
+            info.suffix = r.exact ? joinLiterals(l.suffix, r.exact) : NULL;
+            if (!info.suffix && r.suffix) info.suffix = strdup(r.suffix);
+            info.inner = joinLiterals(l.suffix, r.prefix);
+            info.inner = longerLiteral(info.inner, l.inner);
+            info.inner = longerLiteral(info.inner, r.inner);
+            info.inner = longerLiteral(info.inner, info.prefix ? strdup(info.prefix) : NULL);
+            info.inner = longerLiteral(info.inner, info.suffix ? strdup(info.suffix) : NULL);
+            l.inner = r.inner = NULL;
+        }
+        freeLiteralInfo(&l);
+        freeLiteralInfo(&r);
+    }
+    else if (node->kind == NODE_PAREN) {
+        info = literalInfo(node->left, symbolTable);
+    }
+    else if (node->kind == NODE_SYSTEM) {
+        info = literalInfo(node->right, symbolTable);
+    }
+    else if (node->kind == NODE_SUBSTITUTE) {
+        info = literalInfo(getSymbol(node->left->value, symbolTable), symbolTable);
+    }
+    else if (node->kind == NODE_REPEAT) {
+        if (node->value[0] == '+') { // at least one copy, but not an exact string anymore
+            info = literalInfo(node->left, symbolTable);
+            free(info.exact);
+            info.exact = NULL;
+        }
+    }
+    else if (node->kind == NODE_ALT) {
+        LiteralInfo l = literalInfo(node->left, symbolTable);
+        LiteralInfo r = literalInfo(node->right, symbolTable);
+        if (l.exact && r.exact && strcmp(l.exact, r.exact) == 0) {
+            info = l;
+            l.exact = l.prefix = l.suffix = l.inner = NULL;
+        }
+        else {
+            if (l.prefix && r.prefix) { // common prefix of both branches
+                int n = 0;
+                while (l.prefix[n] && l.prefix[n] == r.prefix[n]) n++;
+                if (n > 0) info.prefix = strndup(l.prefix, n);
+            }
+            if (l.suffix && r.suffix) { // common suffix of both branches
+                int a = strlen(l.suffix), b = strlen(r.suffix), n = 0;
+                while (n < a && n < b && l.suffix[a - 1 - n] == r.suffix[b - 1 - n]) n++;
+                if (n > 0) info.suffix = strdup(l.suffix + a - n);
+            }
+            info.inner = info.prefix ? strdup(info.prefix) : NULL;
+            info.inner = longerLiteral(info.inner, info.suffix ? strdup(info.suffix) : NULL);
+        }
+        freeLiteralInfo(&l);
+        freeLiteralInfo(&r);
+    }
+    else if (node->kind == NODE_RANGE || node->kind == NODE_NEGRANGE || node->kind == NODE_WILD
+        || node->kind == NODE_UNICODE || node->kind == NODE_CONCAT || node->kind == NODE_NOTREGEX) {
+        // nothing is known about a single class byte, and & / ! are handled by findLiterals()
+    }
+    else if (node->value && node->value[0]) { // characters inside quotes match their own text
+        info = exactLiteral(node->value);
+    }
+    return info;
+}
+
+// Collect the factors of the whole pattern. Every non inverted sub regex of & must match,
+// so each of them contributes; inverted ones tell us nothing.
+void collectLiterals(ASTNode *node, Symbol *symbolTable) {
+    if (node == NULL) return;
+    if (node->kind == NODE_SYSTEM) {
+        collectLiterals(node->right, symbolTable);
+        return;
+    }
+    if (node->kind == NODE_CONCAT) {
+        collectLiterals(node->left, symbolTable);
+        collectLiterals(node->right, symbolTable);
+        return;
+    }
+    if (node->kind == NODE_NOTREGEX) return;
+    LiteralInfo info = literalInfo(node, symbolTable);
+    requiredPrefix = longerLiteral(requiredPrefix, info.prefix);
+    requiredSuffix = longerLiteral(requiredSuffix, info.suffix);
+    requiredInner = longerLiteral(requiredInner, info.inner);
+    free(info.exact);
+}
+
+void findLiterals(ASTNode *root, Symbol *symbolTable) {
+    if (!prefilterEnabled) return;
+    collectLiterals(root, symbolTable);
+    // the inner factor only pays off when the ends do not already cover it
+    if (requiredInner && ((requiredPrefix && strstr(requiredPrefix, requiredInner))
+        || (requiredSuffix && strstr(requiredSuffix, requiredInner)))) {
+        free(requiredInner);
+        requiredInner = NULL;
+    }
+    if (dfaStats) {
+        printf("Required prefix: %s\n", requiredPrefix ? requiredPrefix : "(none)");
+        printf("Required suffix: %s\n", requiredSuffix ? requiredSuffix : "(none)");
+        printf("Required infix: %s\n", requiredInner ? requiredInner : "(none)");
+    }
+}
+
+void freeLiterals() {
+    free(requiredPrefix); free(requiredSuffix); free(requiredInner);
+    requiredPrefix = requiredSuffix = requiredInner = NULL;
+}
+
+int hasPrefilter() {
+    return requiredPrefix || requiredSuffix || requiredInner;
+}
+
+void literalArray(FILE *file, const char *name, const char *s) {
+    int n = s ? strlen(s) : 0;
+    fprintf(file, "static const unsigned char %s[%d] = {", name, n + 1);
+    for (int i = 0; i < n; i++) fprintf(file, "0x%02x,", (unsigned char)s[i]);
+    fprintf(file, "0};\n#define %s_LEN %d\n", name, n);
+}
+
+// prefilter(buf, len) for records in memory and prefilter_file(f) for regular files, which reads
+// the head and the tail with pread and searches a mapping for the infix, so the stream itself
+// is left untouched
+void prefilterCode(FILE *file) {
+    fprintf(file,
+        "#include <unistd.h>\n"
+        "#include <sys/mman.h>\n"
+        "#include <sys/stat.h>\n"
+        "#ifdef __SSE2__\n"
+        "#include <emmintrin.h>\n"
+        "#endif\n\n"
+    );
+    literalArray(file, "PREFIX", requiredPrefix);
+    literalArray(file, "SUFFIX", requiredSuffix);
+    literalArray(file, "INFIX", requiredInner);
+    fprintf(file,
+        "\n"
+        "// 1 if lit occurs in input. 16 candidate positions are tested at a time by comparing the\n"
+        "// first and the last byte of lit, only candidates with both in place go to memcmp\n"
+        "static int find_literal(const unsigned char *input, long len, const unsigned char *lit, long m) {\n"
+        "    long i = 0;\n"
+        "    if (m == 0) return 1;\n"
+        "#ifdef __SSE2__\n"
+        "    const __m128i first = _mm_set1_epi8((char)lit[0]);\n"
+        "    const __m128i last = _mm_set1_epi8((char)lit[m - 1]);\n"
+        "    for (; i + m + 15 <= len; i += 16) {\n"
+        "        __m128i a = _mm_loadu_si128((const __m128i *)(input + i));\n"
+        "        __m128i b = _mm_loadu_si128((const __m128i *)(input + i + m - 1));\n"
+        "        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));\n"
+        "        while (mask) {\n"
+        "            if (memcmp(input + i + __builtin_ctz(mask), lit, m) == 0) return 1;\n"
+        "            mask &= mask - 1;\n"
+        "        }\n"
+        "    }\n"
+        "#endif\n"
+        "    for (; i + m <= len; i++) {\n"
+        "        const unsigned char *p = memchr(input + i, lit[0], len - m + 1 - i);\n"
+        "        if (!p) return 0;\n"
+        "        i = p - input;\n"
+        "        if (memcmp(p, lit, m) == 0) return 1;\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n\n"
+
+        "// 0 when a literal every match needs is missing from the record\n"
+        "int prefilter(const unsigned char *input, long len) {\n"
+        "    if (len < PREFIX_LEN || memcmp(input, PREFIX, PREFIX_LEN) != 0) return 0;\n"
+        "    if (len < SUFFIX_LEN || memcmp(input + len - SUFFIX_LEN, SUFFIX, SUFFIX_LEN) != 0) return 0;\n"
+        "    return find_literal(input, len, INFIX, INFIX_LEN);\n"
+        "}\n\n"
+
+        "// 0 when a regular file misses one of the required literals; pipes pass\n"
+        "int prefilter_file(FILE *f) {\n"
+        "    struct stat st;\n"
+        "    unsigned char head[PREFIX_LEN + 1], tail[SUFFIX_LEN + 1];\n"
+        "    if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return 1;\n"
+        "    if (st.st_size < PREFIX_LEN || st.st_size < SUFFIX_LEN || st.st_size < INFIX_LEN) return 0;\n"
+        "    if (pread(fileno(f), head, PREFIX_LEN, 0) != PREFIX_LEN || memcmp(head, PREFIX, PREFIX_LEN) != 0) return 0;\n"
+        "    if (pread(fileno(f), tail, SUFFIX_LEN, st.st_size - SUFFIX_LEN) != SUFFIX_LEN) return 0;\n"
+        "    if (memcmp(tail, SUFFIX, SUFFIX_LEN) != 0) return 0;\n"
+        "    if (INFIX_LEN == 0) return 1;\n"
+        "    // the infix can be anywhere, so the whole file is searched in place\n"
+        "    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);\n"
+        "    if (p == MAP_FAILED) return 1; // the automaton decides\n"
+        "    madvise(p, st.st_size, MADV_SEQUENTIAL);\n"
+        "    int found = find_literal(p, st.st_size, INFIX, INFIX_LEN);\n"
+        "    munmap(p, st.st_size);\n"
+        "    return found;\n"
+        "}\n\n"
+    );
+}
@@ -0,0 +1,109 @@
+/*
+    In process matching (generate --match <input>). The lowered NFA is determinized on demand
+    while the input is read: a DFA state gets its row of the table the first time it is left on
+    a byte class, so only the states the input visits are ever built. No C is written and
+    nothing is compiled, which suits patterns that change between runs.
+*/
+
+#define MATCH_CACHE_STATES 10000 // DFA states kept before the table is thrown away and rebuilt
+
+const char *matchPath = NULL; // set by --match
+int matchFailed = 0; // the input given to --match could not be read
+
+// Forget every DFA state but the dead one and cur, which is renumbered; used when the table
+// is full
+int resetMatchCache(int cur) {
+    int n = dfaSetSize[cur];
+    int *keep = (int *)malloc((n ? n : 1) * sizeof(int));
+    memcpy(keep, dfaSets[cur], n * sizeof(int));
+    for (int d = 0; d < dfaCount; d++) free(dfaSets[d]);
+    dfaCount = 0;
+    for (int i = 0; i < dfaHashCap; i++) dfaHash[i] = -1;
+    addDfaState(keep, 0); // dead state
+    cur = addDfaState(keep, n);
+    free(keep);
+    return cur;
+}
+
+// 1 when the verdict in DFA state d is fixed: a sub regex of & has no states left or one of !
+// holds a universal state, or every sub is either gone or universal. universal[] caches
+// lazyUniversal() per NFA state, -1 while unknown.
+int matchSettled(int d, signed char *universal, unsigned char *live, unsigned char *sure,
+    int *seed, int *set) {
+    memset(live, 0, startCount);
+    memset(sure, 0, startCount);
+    for (int i = 0; i < dfaSetSize[d]; i++) {
+        int s = dfaSets[d][i], k = ownerSub[s];
+        if (k < 0) continue;
+        live[k] = 1;
+        if (universal[s] < 0) universal[s] = lazyImportant(s) && lazyUniversal(s, seed, set);
+        if (universal[s]) sure[k] = 1;
+    }
+    int open = 0;
+    for (int k = 0; k < startCount; k++) {
+        if (live[k] && !sure[k]) { open = 1; continue; }
+        if (live[k] == invertFlags[k]) return 1;
+    }
+    return !open;
+}
+
+// 1 if the whole input at path matches, 0 if not, -1 if it cannot be read
+int matchInProcess(const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    prepareLowered();
+    int *seed = (int *)malloc(byteCount * sizeof(int));
+    int *set = (int *)malloc(byteCount * sizeof(int));
+    signed char *universal = (signed char *)malloc(byteCount);
+    memset(universal, -1, byteCount);
+    unsigned char *live = (unsigned char *)malloc(startCount), *sure = (unsigned char *)malloc(startCount);
+    addDfaState(set, 0); // dead state
+    int state = addDfaState(set, startClosure(seed, set));
+    int rows = 0; // states whose table row is initialized to unknown (-1) and settled[] is known
+    unsigned char *settled = NULL;
+    int settledCap = 0;
+
+    static unsigned char buf[65536];
+    size_t n = 0, i = 0;
+    for (;;) {
+        for (; rows < dfaCount; rows++) {
+            for (int k = 0; k < classCount; k++) dfaTable[rows * classCount + k] = -1;
+            if (rows == settledCap) {
+                settledCap = settledCap ? settledCap * 2 : 256;
+                settled = (unsigned char *)realloc(settled, settledCap);
+            }
+            settled[rows] = matchSettled(rows, universal, live, sure, seed, set);
+        }
+        if (settled[state]) break; // dead or universal, the rest of the input cannot change the verdict
+        if (i == n) {
+            i = 0;
+            if ((n = fread(buf, 1, sizeof(buf), f)) == 0) break;
+        }
+        int k = byteClass[buf[i]];
+        int next = dfaTable[state * classCount + k];
+        if (next < 0) {
+            if (dfaCount >= MATCH_CACHE_STATES) { // start over from the renumbered state, buf[i] is not consumed
+                state = resetMatchCache(state);
+                rows = 0;
+                continue;
+            }
+            next = dfaMove(state, k, seed, set); // may realloc dfaTable, so store afterwards
+            dfaTable[state * classCount + k] = next;
+        }
+        state = next;
+        i++;
+    }
+    int accept = dfaAccept[state];
+    if (f != stdin) fclose(f);
+    free(seed);
+    free(set);
+    free(universal);
+    free(live);
+    free(sure);
+    free(settled);
+    freeDfa();
+    return accept;
+}
@@ -0,0 +1,377 @@
+/*
+    Pattern sets (--set). Every system of the file is one pattern, numbered from 0 in file
+    order, and all of them are determinized into a single DFA, so one pass over the input tells
+    which of them match however many there are (like RE2::Set).
+
+    Remembering in every DFA state which patterns have already matched for good (a pattern like
+    .*"kw".* once "kw" was seen) would multiply the states by every subset of such patterns.
+    Instead, when a pattern of a single non inverted sub regex reaches a state from which every
+    continuation accepts, its NFA states go back to its start closure, as if it had never
+    matched, and the DFA state records the event with a marker (byteCount + pattern) at the end
+    of its set. The generated scan() adds the patterns of these emitting states to a bitmap as
+    it goes, like the match events of Hyperscan, and the final state supplies the patterns whose
+    verdict depends on the end of the input.
+*/
+
+#define SECURE_LIMIT 64 // state sets explored before a state is assumed not to secure its pattern
+
+int patternCount = 0;
+int subPattern[MAX_SUBNFAS]; // pattern each sub regex of startStates belongs to
+int *securedBy = NULL; // for each byte state, the pattern it secures, or -1
+unsigned char *securedNow = NULL; // scratch of securePatterns(), one flag per pattern
+int **restart = NULL; // start closure a secured pattern goes back to, NULL to drop its states
+int *restartSize = NULL;
+
+// Accept values: the patterns accepting if the input ends here (bits 0 .. patternCount - 1)
+// and the ones secured on entering the state (bits patternCount .. 2 * patternCount - 1)
+unsigned char **acceptSets = NULL;
+int acceptSetCount = 0;
+int acceptSetCap = 0;
+int *acceptHash = NULL; // open addressing from bitmap to accept value
+int acceptHashCap = 0;
+
+// Build the NFA of one more pattern next to the previous ones; 0 when there is no room left
+int addSetPattern(ASTNode *node, Symbol *symbolTable) {
+    int first = startCount;
+    if (startCount == MAX_SUBNFAS) {
+        fprintf(stderr, "Error: more than %d patterns and sub regexes in the set\n", MAX_SUBNFAS);
+        return 0;
+    }
+    hashPattern(node, symbolTable);
+    State *start = generateStates(node, symbolTable);
+    if (startCount == first && start) {
+        startStates[startCount] = start;
+        start->pair->is_accept = 1;
+        invertFlags[startCount++] = 0;
+    }
+    if (startCount == MAX_SUBNFAS) { // & and ! drop their subs silently once the array is full
+        fprintf(stderr, "Error: more than %d patterns and sub regexes in the set\n", MAX_SUBNFAS);
+        return 0;
+    }
+    for (int k = first; k < startCount; k++) subPattern[k] = patternCount;
+    patternCount++;
+    return 1;
+}
+
+int setBytes() {
+    return (2 * patternCount + 7) / 8;
+}
+
+unsigned long hashBits(const unsigned char *bits, int bytes) {
+    unsigned long h = 1469598103934665603UL; // FNV-1a
+    for (int i = 0; i < bytes; i++) {
+        h ^= bits[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+// accept value of a bitmap, which is kept when new and freed otherwise
+int internAcceptSet(unsigned char *bits) {
+    int bytes = setBytes();
+    if (acceptSetCount * 2 >= acceptHashCap) {
+        free(acceptHash);
+        acceptHashCap = acceptHashCap ? acceptHashCap * 2 : 256;
+        acceptHash = (int *)malloc(acceptHashCap * sizeof(int));
+        for (int i = 0; i < acceptHashCap; i++) acceptHash[i] = -1;
+        for (int k = 0; k < acceptSetCount; k++) {
+            unsigned long h = hashBits(acceptSets[k], bytes) & (acceptHashCap - 1);
+            while (acceptHash[h] >= 0) h = (h + 1) & (acceptHashCap - 1);
+            acceptHash[h] = k;
+        }
+    }
+    unsigned long h = hashBits(bits, bytes) & (acceptHashCap - 1);
+    while (acceptHash[h] >= 0) {
+        if (memcmp(acceptSets[acceptHash[h]], bits, bytes) == 0) {
+            free(bits);
+            return acceptHash[h];
+        }
+        h = (h + 1) & (acceptHashCap - 1);
+    }
+    if (acceptSetCount == acceptSetCap) {
+        acceptSetCap = acceptSetCap ? acceptSetCap * 2 : 64;
+        acceptSets = (unsigned char **)realloc(acceptSets, acceptSetCap * sizeof(unsigned char *));
+    }
+    acceptSets[acceptSetCount] = bits;
+    acceptHash[h] = acceptSetCount;
+    return acceptSetCount++;
+}
+
+// Accept value of a DFA state set: every sub regex of a pattern has to accept (or not, when
+// inverted) for the pattern to accept, plus the patterns its markers secure
+int setAccept(int *set, int n) {
+    char hit[MAX_SUBNFAS] = {0};
+    unsigned char *bits = (unsigned char *)calloc(setBytes(), 1);
+    for (int i = 0; i < n; i++) {
+        if (set[i] >= byteCount) { // marker
+            int p = patternCount + set[i] - byteCount;
+            bits[p / 8] |= 1 << (p % 8);
+        }
+        else if (acceptSub[set[i]] >= 0) hit[acceptSub[set[i]]] = 1;
+    }
+    for (int p = 0; p < patternCount; p++) bits[p / 8] |= 1 << (p % 8);
+    for (int i = 0; i < startCount; i++)
+        if (hit[i] == invertFlags[i]) bits[subPattern[i] / 8] &= ~(1 << (subPattern[i] % 8));
+    return internAcceptSet(bits);
+}
+
+// 1 when every input read from state s of sub regex sub ends up accepted by it. The state sets
+// reachable from its closure are walked one class at a time; each must hold the accept state
+// and none may be empty
+int universalState(int s, int sub, int *seed) {
+    int accept = startStates[sub]->pair->id, count = 0, universal = 1;
+    int **sets = (int **)malloc(SECURE_LIMIT * sizeof(int *));
+    int *sizes = (int *)malloc(SECURE_LIMIT * sizeof(int));
+    int *set = (int *)malloc(byteCount * sizeof(int));
+    sizes[0] = epsilonClosure(&s, 1, set);
+    sets[0] = (int *)malloc(sizes[0] * sizeof(int));
+    memcpy(sets[0], set, sizes[0] * sizeof(int));
+    count = 1;
+    for (int i = 0; i < count && universal; i++) {
+        int holds = 0;
+        for (int j = 0; j < sizes[i]; j++) holds |= sets[i][j] == accept;
+        if (!holds) { universal = 0; break; }
+        for (int k = 0; k < classCount && universal; k++) {
+            int seedCount = 0;
+            moveStamp++;
+            for (int j = 0; j < sizes[i]; j++) {
+                for (ByteEdge *e = byteStates[sets[i][j]].edges; e; e = e->next) {
+                    if (BIT_TEST(e->set, classRep[k]) && moveMark[e->to] != moveStamp) {
+                        moveMark[e->to] = moveStamp;
+                        seed[seedCount++] = e->to;
+                    }
+                }
+            }
+            if (seedCount == 0) { universal = 0; break; } // this byte kills the match
+            int n = epsilonClosure(seed, seedCount, set), known = 0;
+            for (int j = 0; j < count && !known; j++)
+                known = sizes[j] == n && memcmp(sets[j], set, n * sizeof(int)) == 0;
+            if (known) continue;
+            if (count == SECURE_LIMIT) { universal = 0; break; }
+            sets[count] = (int *)malloc(n * sizeof(int));
+            memcpy(sets[count], set, n * sizeof(int));
+            sizes[count++] = n;
+        }
+    }
+    for (int i = 0; i < count; i++) free(sets[i]);
+    free(sets);
+    free(sizes);
+    free(set);
+    return universal;
+}
+
+// securedBy[] for the states of every pattern made of one non inverted sub regex, and the start
+// closure each of them restarts from. A start closure that secures the pattern by itself (/.*/)
+// is not used, or the pattern would be secured again on every byte
+void findSecuringStates() {
+    int *subsOf = (int *)calloc(patternCount, sizeof(int));
+    int *seed = (int *)malloc(byteCount * sizeof(int));
+    int *set = (int *)malloc(byteCount * sizeof(int));
+    for (int i = 0; i < startCount; i++) subsOf[subPattern[i]]++;
+    securedBy = (int *)malloc(byteCount * sizeof(int));
+    securedNow = (unsigned char *)calloc(patternCount, 1);
+    restart = (int **)calloc(patternCount, sizeof(int *));
+    restartSize = (int *)calloc(patternCount, sizeof(int));
+    for (int s = 0; s < byteCount; s++) {
+        int sub = ownerSub[s];
+        securedBy[s] = -1;
+        if (sub < 0 || invertFlags[sub] || subsOf[subPattern[sub]] != 1) continue;
+        if (universalState(s, sub, seed)) securedBy[s] = subPattern[sub];
+    }
+    for (int i = 0; i < startCount; i++) {
+        int p = subPattern[i], n = epsilonClosure(&startStates[i]->id, 1, set), again = 0;
+        if (invertFlags[i] || subsOf[p] != 1) continue;
+        for (int j = 0; j < n; j++) again |= securedBy[set[j]] == p;
+        if (again) continue;
+        restart[p] = (int *)malloc(n * sizeof(int));
+        memcpy(restart[p], set, n * sizeof(int));
+        restartSize[p] = n;
+    }
+    free(subsOf);
+    free(seed);
+    free(set);
+}
+
+// Restart the patterns a sorted set secures and append their markers; returns the new size,
+// at most byteCount + patternCount
+int securePatterns(int *set, int n) {
+    int found = 0;
+    for (int i = 0; i < n; i++) {
+        if (securedBy[set[i]] >= 0 && !securedNow[securedBy[set[i]]]) {
+            securedNow[securedBy[set[i]]] = 1;
+            found = 1;
+        }
+    }
+    if (!found) return n;
+    int m = 0;
+    for (int i = 0; i < n; i++) // a fresh closure, so no markers yet
+        if (!securedNow[subPattern[ownerSub[set[i]]]]) set[m++] = set[i];
+    for (int p = 0; p < patternCount; p++) {
+        if (!securedNow[p] || !restart[p]) continue;
+        memcpy(set + m, restart[p], restartSize[p] * sizeof(int));
+        m += restartSize[p];
+    }
+    qsort(set, m, sizeof(int), intCompare);
+    for (int p = 0; p < patternCount; p++) { // markers after every real state, in pattern order
+        if (!securedNow[p]) continue;
+        securedNow[p] = 0;
+        set[m++] = byteCount + p;
+    }
+    return m;
+}
+
+int emittingCount = 0; // states from dfaCount - emittingCount on secure patterns when entered
+
+// Renumber the states that secure patterns to the end, so scan() needs a single compare to spot
+// them; the settled ones among them lose that status, which only costs one more step
+void emitLast() {
+    int n = dfaCount, next = 0, settled = 0;
+    int *newId = (int *)malloc(n * sizeof(int));
+    int *emits = (int *)malloc(n * sizeof(int));
+    for (int d = 0; d < n; d++) {
+        unsigned char *bits = acceptSets[dfaAccept[d]];
+        emits[d] = 0;
+        for (int p = patternCount; p < 2 * patternCount && !emits[d]; p++) emits[d] = bits[p / 8] >> (p % 8) & 1;
+    }
+    for (int d = 0; d < terminalCount; d++) if (!emits[d]) { newId[d] = next++; settled++; }
+    for (int d = terminalCount; d < n; d++) if (!emits[d]) newId[d] = next++;
+    emittingCount = n - next;
+    for (int d = 0; d < n; d++) if (emits[d]) newId[d] = next++;
+
+    int *table = (int *)malloc((long)n * classCount * sizeof(int));
+    int *accept = (int *)malloc(n * sizeof(int));
+    for (int d = 0; d < n; d++) {
+        accept[newId[d]] = dfaAccept[d];
+        for (int c = 0; c < classCount; c++) table[newId[d] * classCount + c] = newId[dfaTable[d * classCount + c]];
+    }
+    dfaStart = newId[dfaStart];
+    terminalCount = settled;
+    free(dfaTable); free(dfaAccept);
+    dfaTable = table;
+    dfaAccept = accept;
+    free(newId);
+    free(emits);
+}
+
+void freeAcceptSets() {
+    for (int k = 0; k < acceptSetCount; k++) free(acceptSets[k]);
+    for (int p = 0; restart && p < patternCount; p++) free(restart[p]);
+    free(acceptSets); free(acceptHash); free(securedBy); free(securedNow); free(restart); free(restartSize);
+    acceptSets = NULL; acceptHash = NULL; securedBy = NULL; securedNow = NULL; restart = NULL; restartSize = NULL;
+    acceptSetCount = acceptSetCap = acceptHashCap = 0;
+}
+
+// patterns with bit base + p set in accept value k, as CSR offsets and ids
+void setListCode(FILE *file, const char *name, int base) {
+    int total = 0, printed = 0;
+    fprintf(file, "static const int %s_first[%d] = {0", name, acceptSetCount + 1);
+    for (int k = 0; k < acceptSetCount; k++) {
+        for (int p = 0; p < patternCount; p++) total += acceptSets[k][(base + p) / 8] >> ((base + p) % 8) & 1;
+        fprintf(file, ",%d", total);
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "static const int %s_patterns[%d] = {", name, total ? total : 1);
+    for (int k = 0; k < acceptSetCount; k++)
+        for (int p = 0; p < patternCount; p++)
+            if (acceptSets[k][(base + p) / 8] >> ((base + p) % 8) & 1) fprintf(file, "%s%d", (printed++ ? "," : ""), p);
+    fprintf(file, "%s};\n", total ? "" : "0");
+}
+
+// rexec.c for the whole set: the table DFA, the patterns of every accept value, and a main() that
+// prints the ids of the matching patterns
+void setCode(FILE *file) {
+    if (cachedOutput()) return;
+    prepareDfa();
+    emitLast();
+    if (dfaStats) printf("Patterns: %d, accept sets: %d, emitting states: %d\n", patternCount, acceptSetCount, emittingCount);
+    fprintf(file,
+        "#include <stdio.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n\n"
+    );
+    dfaTablesCode(file, 1);
+    fprintf(file, "#define START_STATE %d\n", dfaStart);
+    fprintf(file, "#define SETTLED %d // states below this id keep their set of matches\n", terminalCount);
+    fprintf(file, "#define EMITTING %d // states from this id on secure patterns when entered\n", dfaCount - emittingCount);
+    fprintf(file, "#define NUM_PATTERNS %d\n", patternCount);
+    fprintf(file, "#define FOUND_BYTES %d // bitmap of matching patterns\n\n", (patternCount + 7) / 8);
+
+    // patterns accepting when the input ends in a state, then the ones secured on entering it
+    setListCode(file, "final", 0);
+    setListCode(file, "secure", patternCount);
+
+    fprintf(file,
+        "\n"
+        "static void add_patterns(const int *first, const int *patterns, int set, unsigned char *found) {\n"
+        "    for (int k = first[set]; k < first[set + 1]; k++) found[patterns[k] / 8] |= 1 << (patterns[k] %% 8);\n"
+        "}\n\n"
+
+        "// advance from state over one chunk, adding the patterns secured on the way to found\n"
+        "int scan(const unsigned char *input, long len, int state, unsigned char *found) {\n"
+        "    for (long i = 0; i < len && state >= SETTLED; ++i) {\n"
+        "        state = dfa_table[state][dfa_class[input[i]]];\n"
+        "        if (state >= EMITTING) add_patterns(secure_first, secure_patterns, dfa_accept[state], found);\n"
+        "    }\n"
+        "    return state;\n"
+        "}\n\n"
+
+        "int start(unsigned char *found) {\n"
+        "    memset(found, 0, FOUND_BYTES);\n"
+        "    if (START_STATE >= EMITTING) add_patterns(secure_first, secure_patterns, dfa_accept[START_STATE], found);\n"
+        "    return START_STATE;\n"
+        "}\n\n"
+
+        "#define CHUNK_SIZE 65536 // bytes read from the input at a time\n"
+        "#define VERDICT_BYTES FOUND_BYTES\n"
+        "#define REENTRANT_MATCH // scan() only reads the tables\n\n"
+
+        "// patterns matching a whole input\n"
+        "void match_input(FILE *f, unsigned char *found) {\n"
+        "    static unsigned char buf[CHUNK_SIZE];\n"
+        "    int state = start(found);\n"
+        "    size_t n;\n"
+        "    while (state >= SETTLED && (n = fread(buf, 1, CHUNK_SIZE, f)) > 0) state = scan(buf, n, state, found);\n"
+        "    add_patterns(final_first, final_patterns, dfa_accept[state], found);\n"
+        "}\n\n"
+
+        "void match_buffer(const unsigned char *input, long len, unsigned char *found) {\n"
+        "    int state = scan(input, len, start(found), found);\n"
+        "    add_patterns(final_first, final_patterns, dfa_accept[state], found);\n"
+        "}\n\n"
+
+        "long hits[NUM_PATTERNS]; // inputs each pattern matched, for -c\n\n"
+
+        "// ACCEPTS and the matching pattern ids, or REJECTS when there are none\n"
+        "void report(const char *path, const unsigned char *found, int counts) {\n"
+        "    int any = 0;\n"
+        "    for (int p = 0; p < NUM_PATTERNS; p++) {\n"
+        "        if (!(found[p / 8] >> (p %% 8) & 1)) continue;\n"
+        "        hits[p]++;\n"
+        "        if (counts) continue;\n"
+        "        if (!any && path) printf(\"%%s: \", path);\n"
+        "        printf(any ? \" %%d\" : \"ACCEPTS %%d\", p);\n"
+        "        any = 1;\n"
+        "    }\n"
+        "    if (counts) return;\n"
+        "    if (!any) printf(path ? \"%%s: REJECTS\\n\" : \"REJECTS\\n\", path);\n"
+        "    else printf(\"\\n\");\n"
+        "}\n\n"
+
+        "// with -c, how many inputs each pattern matched\n"
+        "void totals(int counts, int files) {\n"
+        "    (void)files;\n"
+        "    if (counts)\n"
+        "        for (int p = 0; p < NUM_PATTERNS; p++) printf(\"%%d: %%ld\\n\", p, hits[p]);\n"
+        "}\n\n"
+    );
+    driverCode(file);
+    fprintf(file,
+        "\n"
+        "int main(int argc, char **argv) {\n"
+        "    return run_inputs(argc, argv);\n"
+        "}\n"
+    );
+    storeOutput();
+    freeAcceptSets();
+    freeDfa();
+}
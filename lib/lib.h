@@ -2,18 +2,80 @@
 #include <stdlib.h>
 #include<string.h>
 
+#include "Arena.h" // bump allocation, released per compilation
+
+// Kinds of AST nodes; the generator switches on these instead of comparing names
+typedef enum NodeKind {
+    NODE_SYSTEM, NODE_DEFINITION, NODE_ID, NODE_CONCAT, NODE_NOTREGEX, NODE_ALT, NODE_SEQ,
+    NODE_PAREN, NODE_REPEAT, NODE_SUBSTITUTE, NODE_RANGE, NODE_NEGRANGE, NODE_RANGE_VAL,
+    NODE_WILD, NODE_LITERAL, NODE_UNICODE,
+    // single characters inside quotes or [ ], value holds their text
+    NODE_RBIG, NODE_QUOTE, NODE_PERCENT, NODE_PLUS, NODE_MINUS, NODE_CONST, NODE_EQUAL,
+    NODE_AMP, NODE_NOT, NODE_LPAR, NODE_RPAR, NODE_PIPE, NODE_QUES, NODE_LBIG, NODE_ESC,
+    NODE_ASTRK, NODE_DOT, NODE_LCUR, NODE_RCUR, NODE_OTHERS,
+    NODE_KINDS
+} NodeKind;
+
+// names of the kinds for printAST() and the symbol table dump
+const char *nodeNames[NODE_KINDS] = {
+    "SYSTEM", "DEFINITION", "ID", "CONCAT", "NOTREGEX", "ALT", "SEQ",
+    "PAREN", "REPEAT", "SUBSTITUTE", "RANGE", "NEGRANGE", "RANGE_VAL",
+    "WILD", "LITERAL", "UNICODE",
+    "RBIG", "QUOTE", "PERCENT", "PLUS", "MINUS", "CONST", "EQUAL",
+    "AMP", "NOT", "LPAR", "RPAR", "PIPE", "QUES", "LBIG", "ESC",
+    "ASTRK", "DOT", "LCUR", "RCUR", "OTHERS"
+};
+
+// Interned copies of node values and symbol names live in astArena, so equal strings share
+// one pointer and the symbol tables compare pointers instead of characters
+char **internTable = NULL; // open addressing, internCap is a power of two
+int internCap = 0;
+int internCount = 0;
+
+unsigned int internHash(const char *s) {
+    unsigned int h = 2166136261u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+char *internString(const char *s) {
+    if (s == NULL) return NULL;
+    if (2 * (internCount + 1) > internCap) { // keep the table at most half full
+        int cap = internCap ? internCap * 2 : 1024;
+        char **table = (char **)calloc(cap, sizeof(char *));
+        for (int i = 0; i < internCap; i++) {
+            if (internTable[i] == NULL) continue;
+            unsigned int k = internHash(internTable[i]) & (cap - 1);
+            while (table[k]) k = (k + 1) & (cap - 1);
+            table[k] = internTable[i];
+        }
+        free(internTable);
+        internTable = table;
+        internCap = cap;
+    }
+    unsigned int k = internHash(s) & (internCap - 1);
+    while (internTable[k]) {
+        if (strcmp(internTable[k], s) == 0) return internTable[k];
+        k = (k + 1) & (internCap - 1);
+    }
+    internCount++;
+    return internTable[k] = arenaStrdup(&astArena, s);
+}
+
 struct ASTNode;
 // Symbol Table Entry
 typedef struct Symbol {
     char *name; //symbol
     struct Symbol *next; //next symbol
     struct ASTNode *node; // pointer to ASTNode
+    int visit; // recursiveSymbol(): 0 not reached yet, 1 on the current path, 2 free of cycles
 } Symbol;
 
 // AST Node Structure
 typedef struct ASTNode {
-    char *type; //name for the node
-    char *value; // value of the node
+    NodeKind kind; // what the node stands for, nodeNames[kind] is its name
+    char *value; // value of the node, interned
+    long code; // code point of a UNICODE node
     struct ASTNode *left; //if sub-branches, then pointer to left sub node
     struct ASTNode *right; //if sub-branches, then pointer to right sub node
 } ASTNode;
@@ -21,15 +83,10 @@ typedef struct ASTNode {
 
 // Function to insert into symbol table. Use pointer to pointer to update on global
 void insertSymbol(char *name, ASTNode *val, Symbol **symbolTable) {
-    Symbol *newSymbol = (Symbol *)malloc(sizeof(Symbol)); // allocate size for Symbol
-    if (!newSymbol) {
-        printf("Memory allocation failed!\n");
-        return;
-    }
-    if(val != NULL){ // add nodes to the symbol table if not NULL
-        newSymbol->node = val; // save value of the node
-    }
-    newSymbol->name=strdup(name); // save name
+    Symbol *newSymbol = (Symbol *)arenaAlloc(&astArena, sizeof(Symbol)); // allocate size for Symbol
+    newSymbol->node = val; // save value of the node, NULL for the unknown symbols
+    newSymbol->visit = 0;
+    newSymbol->name = internString(name); // save name
     newSymbol->next = *symbolTable; // next symbol
     *symbolTable = newSymbol; //save to the original pointer
     //printf("Symbol inserted: %s \n",(*symbolTable)->name);
@@ -38,8 +95,9 @@ void insertSymbol(char *name, ASTNode *val, Symbol **symbolTable) {
 // Function to check if symbol exists
 int checkSymbol(char *name, Symbol *symbolTable) {
     Symbol *current = symbolTable; // copy reference start of symbol table to current
+    name = internString(name); // same text, same pointer
     while (current) { // do until current is null
-        if (strcmp(current->name, name) == 0){ //verify if the name of current and the check string is same
+        if (current->name == name){ //verify if the name of current and the check string is same
             return 1;
         }
         current = current->next; // if not, move to next symbol in the table
@@ -50,14 +108,35 @@ int checkSymbol(char *name, Symbol *symbolTable) {
 // Function to check if symbol exists
 ASTNode* getSymbol(char *name, Symbol *symbolTable) {
     Symbol *current = symbolTable; // copy reference start of symbol table to current
+    name = internString(name); // node values are interned already, so this is one probe
     while (current) { // do until current is null
-        if (strcmp(current->name, name) == 0){ //verify if the name of current and the check string is same
+        if (current->name == name){ //verify if the name of current and the check string is same
             return current->node;
         }
         current = current->next; // if not, move to next symbol in the table
     }
     return NULL; // return 0 when no symbol in the table matches check string
 }
+
+// Name of a definition that reaches itself through ${ } below node, NULL when there is none;
+// the generator would expand such a definition forever
+char *recursiveSymbol(ASTNode *node, Symbol *symbolTable) {
+    if (node == NULL) return NULL;
+    if (node->kind == NODE_SUBSTITUTE) {
+        char *name = internString(node->left->value);
+        Symbol *current = symbolTable;
+        while (current && current->name != name) current = current->next;
+        if (current == NULL || current->visit == 2) return NULL; // undefined symbols are reported later
+        if (current->visit == 1) return current->name;
+        current->visit = 1;
+        name = recursiveSymbol(current->node, symbolTable);
+        current->visit = name ? 1 : 2;
+        return name;
+    }
+    char *name = recursiveSymbol(node->left, symbolTable);
+    return name ? name : recursiveSymbol(node->right, symbolTable);
+}
+
 // Function to print the symbol table
 void printSymbolTable(Symbol *table) {
     if(table == NULL){
@@ -73,8 +152,8 @@ void printSymbolTable(Symbol *table) {
 
     while (test != NULL) {
         printf("| %-14s |", test->name);
-        if(test->node->type){
-            printf(" %-14s |\n", test->node->type);
+        if(test->node){
+            printf(" %-14s |\n", nodeNames[test->node->kind]);
         }
         test = test->next;
     }
@@ -82,29 +161,12 @@ void printSymbolTable(Symbol *table) {
     printf("+----------------+\n");
 }
 
-// Function to free the symbol table
-void freeSymbolTable(Symbol *table) {
-    if(table == NULL){
-        return;
-    }
-
-    freeSymbolTable(table->next); // recursively free each symbol in the table
-
-    if(table->name != NULL){ // free name if not NULL
-        free(table->name);
-        table->name=NULL;
-    }
-    
-    free(table); // free the table
-    table=NULL; // make sure to keep the table NULL to avoid dangling pointers
-}
-
-
 // Function to create an AST node
-ASTNode* createNode(char *type, char *value, ASTNode *left, ASTNode *right) {
-    ASTNode *node = (ASTNode *)malloc(sizeof(ASTNode)); // allocate size of ASTNode
-    node->type = strdup(type); // get the type
-    node->value = value ? strdup(value): NULL; // check if value is NULL, if not save the value
+ASTNode* createNode(NodeKind kind, char *value, ASTNode *left, ASTNode *right) {
+    ASTNode *node = (ASTNode *)arenaAlloc(&astArena, sizeof(ASTNode)); // allocate size of ASTNode
+    node->kind = kind; // get the kind
+    node->value = internString(value); // NULL stays NULL
+    node->code = 0;
     node->left = left; // left sub node
     node->right = right; // right sub node
     return node; // return the new node
@@ -119,7 +181,7 @@ void printAST(ASTNode *node, int depth) {
     for (int i = 0; i < depth; i++)
         printf("  ");
 
-    printf("|-%s", node->type);
+    printf("|-%s", nodeNames[node->kind]);
     if (node->value)
         printf(" -%s", node->value);
     printf("\n");
@@ -129,45 +191,33 @@ void printAST(ASTNode *node, int depth) {
     printAST(node->right, depth + 1);
 }
 
-// Recursive function to free each subnode of AST
-void freeAST(ASTNode *node) {
-    if (node == NULL)
-        return;
-
-    // printf("Freeing AST:%s %s\n",node->type,node->value);
-
-    freeAST(node->left); // recursively free left subnode
-    freeAST(node->right); // recursively free right subnode
-
-    if(node->type != NULL){ // free type if not NULL
-        free(node->type);
-        node->type=NULL;
-    }
-    if(node->value != NULL){ // free value if not NULL
-        free(node->value);
-        node->value=NULL;
-    }
-    free(node); // free the node
-    node=NULL; // make sure to keep the node NULL to avoid dangling pointers
+// Drop every AST node, symbol and interned string at once
+void releaseAST() {
+    arenaRelease(&astArena);
+    free(internTable);
+    internTable = NULL;
+    internCap = internCount = 0;
 }
 
-
 typedef struct State State; // Forward declaration of State structure
 typedef struct Transition Transition; // Forward declaration of Transition structure
 
 
 enum TYPE{ // define the types of transitions
     TYPE_DEFAULT,
-    TYPE_WILDCARD,
-    TYPE_UNICODE
+    TYPE_CHARSET
 };
 struct Transition {
     char* match; // NULL = epsilon
-    int type; // 0 = default, 1 = wildcard, 2 = unicode
+    int type; // 0 = default, 1 = charset
     State* to;
     Transition* next; // linked list of transitions
+    unsigned char *set; // 256 bit bitmap of the bytes a charset transition accepts
 };
 
+#define BIT_SET(set, c) ((set)[(c) >> 3] |= (unsigned char)(1 << ((c) & 7)))
+#define BIT_TEST(set, c) ((set)[(c) >> 3] & (1 << ((c) & 7)))
+
 struct State {
     int id;
     int is_accept;
@@ -178,336 +228,374 @@ struct State {
 };
 
 //concat multiple NFA and NOTREGEX
-#define MAX_SUBNFAS 100 // maximum number of sub NFAs
+#define MAX_SUBNFAS 1024 // maximum number of sub NFAs, over all patterns with --set
 State* startStates[MAX_SUBNFAS];
 int invertFlags[MAX_SUBNFAS]; //not accepting states
 int startCount = 0; 
 
+enum GENMODE{ // define the kinds of rexec.c the generator can emit
+    GEN_NFA, // linked State/Transition structs simulated at runtime
+    GEN_DFA, // dense table built by subset construction
+    GEN_GOTO, // the same DFA emitted as labeled blocks with switch and goto
+    GEN_LAZY, // DFA states built on demand at runtime inside a bounded cache
+    GEN_LIB, // the DFA as a reentrant library, rexec.h and rexec.c without main()
+    GEN_SAVE // the DFA as a binary automaton file, rexec.fsm, for the generic runner
+};
+int genMode = GEN_NFA;
+int setMode = 0; // --set: every system of the file is one pattern of a combined DFA
+int dfaStats = 0; // --stats: print automaton sizes and required literals while generating
+
 
 // Global state tracking
 // State* all_states_tail = NULL;
 State* all_states = NULL; // pointer to the first state
 int state_id = 0;
 
-State *existing_states[MAX_SUBNFAS*1024];
-int noOfLiveStates = 0;
-
-//for range states and transitions
-int unicode = 0;
-int minusEncountered = 0;
-
-
-
-void freeTransitions(Transition *t) {
-    if (t == NULL)
-        return;
-
-    if(t->match != NULL) { // free match if not NULL
-        free(t->match);
-        t->match=NULL;
-    }
-
-    freeTransitions(t->next); // recursively free right subnode
-    free(t); // free the node
-    t=NULL; // make sure to keep the node NULL to avoid dangling pointers
-}
-
-
-void freeStates(State *e[]) {
-    for(int i = 0; i < noOfLiveStates; i++) {
-        if(e[i] != NULL) { // free state if not NULL
-            freeTransitions(e[i]->transitions); // free transitions of the state
-            free(e[i]); // free the state
-            e[i]=NULL; // make sure to keep the state NULL to avoid dangling pointers
-        }
-    }
+// Drop the whole NFA at once; the Transitions, their strings and bitmaps go with the States
+void releaseStates() {
+    arenaRelease(&nfaArena);
+    all_states = NULL;
+    state_id = 0;
+    startCount = 0;
 }
 
 State* createState(int is_accept) {
-    State* s = (State *)malloc(sizeof(State));
+    State* s = (State *)arenaAlloc(&nfaArena, sizeof(State));
     s->id = state_id++;
     s->is_accept = is_accept;
     s->transitions = NULL;
-    noOfLiveStates++;
+    s->node = NULL;
+    s->pair = NULL;
     s->next = all_states; 
     all_states = s; // set the current state to the new state
     return s;
 }
 
 void addTransition(State* from, char *match, State* to) {
-    Transition* t = (Transition *)malloc(sizeof(Transition));
-    t->match = (match!=NULL) ? strdup(match) : NULL; // copy the match string
+    Transition* t = (Transition *)arenaAlloc(&nfaArena, sizeof(Transition));
+    t->match = (match!=NULL) ? arenaStrdup(&nfaArena, match) : NULL; // copy the match string
     t->to = to;
     t->type= TYPE_DEFAULT;
+    t->set = NULL;
     t->next = from->transitions;
     from->transitions = t;
 }
 
-void addTransitionReverse(State* from, char *match, State* to) {
-    Transition* t = (Transition *)malloc(sizeof(Transition));
-    t->match = (match!=NULL) ? strdup(match) : NULL; // copy the match string
-    t->to = to;
-    t->type= TYPE_DEFAULT;
-    from->transitions->next = t;
-}
-
 void addTransitionWithType(State* from, char *match, int type, State* to) {
-    Transition* t = (Transition *)malloc(sizeof(Transition));
-    t->match = (match!=NULL) ? strdup(match) : NULL; // copy the match string
+    Transition* t = (Transition *)arenaAlloc(&nfaArena, sizeof(Transition));
+    t->match = (match!=NULL) ? arenaStrdup(&nfaArena, match) : NULL; // copy the match string
     t->to = to;
     t->type=type; 
+    t->set = NULL;
     t->next = from->transitions;
     from->transitions = t;
 }
 
-char addRangeTransitions(ASTNode* node, State* start, State* end) {
-    if (!node) return '\0'; 
+// Transition on any byte whose bit is set; several byte ranges between the same two states
+// all go into the bitmap of a single transition
+void addCharsetRange(State* from, int lo, int hi, State* to) {
+    Transition *t = from->transitions;
+    while (t && !(t->type == TYPE_CHARSET && t->to == to)) t = t->next;
+    if (t == NULL) {
+        addTransitionWithType(from, "", TYPE_CHARSET, to);
+        t = from->transitions;
+        t->set = (unsigned char *)arenaCalloc(&nfaArena, 32);
+    }
+    for (int c = lo; c <= hi; c++) BIT_SET(t->set, c);
+}
 
-    if (strcmp(node->type, "RANGE_VAL") == 0){
-        if(strcmp(node->left->type,"RANGE_VAL") == 0) { // if there is more range values
-        
-            char low = addRangeTransitions(node->left, start, end); // recursively add transitions for the left side of the range
-
-            
-            if(low != '\0'){
-                if(low == '\n'){ // if unicode range is consumed
-                    minusEncountered = 0;
-                    if(strcmp(node->right->type,"UNICODE")==0){
-                        long hi;
-                        sscanf(node->right->value, "%%x%lx;", &hi);
-                        return (char)(int)hi;
-                    }
-                    else{
-                        for (int i=0; i < strlen(node->right->value)-1; ++i) { // add all transitions but the last
-                            char c = node->right->value[i];
-                            char buf[2] = { c, '\0' };
-                            addTransition(start, buf, end); 
-                        }
-                        return node->right->value[strlen(node->right->value) - 1]; // last character of right value
-                    }
-                }
-                if(!minusEncountered){
-                    if(strcmp(node->right->type,"MINUS") == 0){
-                        minusEncountered=1;
-                        return low;
-                    }
-                    if(unicode){
-                        unicode=0;
-                        char buf[12];
-                        sprintf(buf, "%d", (int)low); // convert low to string
-                        addTransitionWithType(start, buf, TYPE_UNICODE, end);
-                        if(strcmp(node->right->type,"UNICODE")==0){
-                            long hi;
-                            unicode = 1;
-                            sscanf(node->right->value, "%%x%lx;", &hi);
-                            return (char)(int)hi;
-                        }
-                        else{
-                            for (int i=0; i < strlen(node->right->value)-1; ++i) { // add all transitions but the last
-                                char c = node->right->value[i];
-                                char buf[2] = { c, '\0' };
-                                addTransition(start, buf, end);
-                            }
-                            return node->right->value[strlen(node->right->value) - 1]; // last character of right value
-                        }   
-                    }
-                    else{
-                        char buf[2]={low, '\0'};
-                        addTransition(start, buf, end);
-                        if(strcmp(node->right->type,"UNICODE")==0){
-                            long hi;
-                            unicode = 1;
-                            sscanf(node->right->value, "%%x%lx;", &hi);
-                            return (char)(int)hi;
-                        }
-                        else{
-                            for (int i=0; i < strlen(node->right->value)-1; ++i) { // add all transitions but the last
-                                char c = node->right->value[i];
-                                char buf[2] = { c, '\0' };
-                                addTransition(start, buf, end);
-                            }
-                            return node->right->value[strlen(node->right->value) - 1]; // last character of right value
-                        }
-                    }
-                }
-                minusEncountered=0;
-                if(!unicode && strcmp(node->right->type,"UNICODE")!=0){
-                    char hi = node->right->value[0];
-                    for (char c = low; c <= hi && low!='\n'; ++c) { //define range of transitions
-                        char buf[2] = { c, '\0' };
-                        addTransition(start, buf, end);
-                    }
-                    for (int i=1; i < strlen(node->right->value)-1; ++i) { // add all transitions but the last
-                        char c = node->right->value[i];
-                        char buf[2] = { c, '\0' };
-                        addTransition(start, buf, end);
-                    }
-                    return node->right->value[strlen(node->right->value) - 1]; // last character of right value
-                }
-                else{
-                    long hi;
-                    int l = (int) low;
-                    unicode=0;
-                    minusEncountered = 0;
-                    if(strcmp(node->right->type,"UNICODE")==0){
-                        sscanf(node->right->value, "%%x%lx;", &hi);
-                        for (int i = l; i <= hi; ++i) { //define range of transitions
-                            char buf[12];
-                            sprintf(buf, "%d", (int)i); // convert i to string
-                            addTransitionWithType(start, buf, TYPE_UNICODE, end); // add transition to the start state
-                        }
-                        return '\n';
-                    }
-                    else{
-                        hi = (int)node->right->value[0];
-                        for (int i = l; i <= hi; ++i) { //define range of transitions
-                            char buf[12];
-                            sprintf(buf, "%d", (int)i); // convert i to string
-                            addTransitionWithType(start, buf, TYPE_UNICODE, end); // add transition to the start state
-                        }
-                        for (int i=1; i < strlen(node->right->value)-1; ++i) { // add all transitions but the last (done as unicode as can be any characters)
-                            char c = node->right->value[i];
-                            char buf[12];
-                            sprintf(buf, "%d", (int)i); // convert i to string
-                            addTransitionWithType(start, buf, TYPE_UNICODE, end);
-                        }
-                        if(strlen(node->right->value)>1)
-                            return node->right->value[strlen(node->right->value) - 1]; // last character of right value
-                        else
-                            return '\n';
-                    }
-                }
-            }
-            else{
-                if(strcmp(node->right->type,"UNICODE")==0){
-                    long i;
-                    sscanf(node->right->value, "%%x%lx;", &i);
-                    char buf[12];
-                    sprintf(buf, "%d", (int)i); // convert i to string
-                    addTransitionWithType(start, buf, TYPE_UNICODE, end);
-                }
-                else{
-                    for (int i=0; i < strlen(node->right->value); ++i) { // add all transitions but the last#FIXME
-                        char c = node->right->value[i];
-                        char buf[2] = { c, '\0' };
-                        addTransition(start, buf, end);
-                    }
-                }
-                return '\0';
-            }
+// Character classes are sets of code points, kept as sorted disjoint [lo, hi] intervals and
+// compiled to UTF-8 byte sequences the way RE2 does, so a wide range costs a few states
+typedef struct CodeRange {
+    long lo;
+    long hi;
+} CodeRange;
+
+#define MAX_CODEPOINT 0x10FFFF
+#define RANGE_MINUS -1 // a '-' inside [...]
+#define RAW_BYTE 0x200000 // flag for a byte of quoted text that still has to be decoded
+
+long *rangeAtoms = NULL; // the members of one class in source order
+int atomCount = 0;
+int atomCap = 0;
+
+void pushAtom(long atom) {
+    if (atomCount == atomCap) {
+        atomCap = atomCap ? atomCap * 2 : 64;
+        rangeAtoms = (long *)realloc(rangeAtoms, atomCap * sizeof(long));
+    }
+    rangeAtoms[atomCount++] = atom;
+}
+
+// flatten the RANGE_VAL tree into atoms, left to right
+void flattenRange(ASTNode *node) {
+    if (node == NULL) return;
+    switch (node->kind) {
+    case NODE_RANGE_VAL:
+        flattenRange(node->left);
+        flattenRange(node->right);
+        break;
+    case NODE_MINUS: pushAtom(RANGE_MINUS); break;
+    case NODE_UNICODE: pushAtom(node->code); break;
+    case NODE_PERCENT: pushAtom('%'); break;
+    default:
+        for (const char *p = node->value; *p; p++) pushAtom(RAW_BYTE | (unsigned char)*p);
+    }
+}
+
+// Decode the UTF-8 sequence of raw bytes at rangeAtoms[*i]; a byte which does not start a
+// valid sequence stands for itself as a Latin-1 code point
+long decodeAtom(int *i) {
+    long b = rangeAtoms[*i] & 0xff;
+    int n = b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : b >= 0xc0 ? 2 : 1;
+    long cp = n == 1 ? b : b & (0x3f >> (n - 1));
+    for (int k = 1; k < n; k++) {
+        long a = *i + k < atomCount ? rangeAtoms[*i + k] : 0;
+        if (a < RAW_BYTE || (a & 0xc0) != 0x80) { (*i)++; return b; }
+        cp = (cp << 6) | (a & 0x3f);
+    }
+    static const long minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (cp < minimum[n] || cp > MAX_CODEPOINT || (cp >= 0xd800 && cp <= 0xdfff)) { (*i)++; return b; }
+    *i += n;
+    return cp;
+}
+
+int compareCodeRanges(const void *a, const void *b) {
+    long x = ((const CodeRange *)a)->lo, y = ((const CodeRange *)b)->lo;
+    return (x > y) - (x < y);
+}
+
+// Code point set of a [...] body, complemented over all of Unicode for [^...]. Returns the
+// number of intervals written to *out (malloc'ed)
+int classRanges(ASTNode *node, int negate, CodeRange **out) {
+    atomCount = 0;
+    flattenRange(node);
+    int count = 0;
+    for (int i = 0; i < atomCount; ) { // decode in place
+        if (rangeAtoms[i] >= RAW_BYTE) rangeAtoms[count++] = decodeAtom(&i);
+        else rangeAtoms[count++] = rangeAtoms[i++];
+    }
+    atomCount = count;
+
+    // a '-' between two members makes a range, anywhere else it is the character itself
+    CodeRange *r = (CodeRange *)malloc((atomCount + 1) * sizeof(CodeRange));
+    int n = 0;
+    for (int i = 0; i < atomCount; i++) {
+        long lo = rangeAtoms[i] == RANGE_MINUS ? '-' : rangeAtoms[i], hi = lo;
+        if (rangeAtoms[i] != RANGE_MINUS && i + 2 < atomCount && rangeAtoms[i + 1] == RANGE_MINUS
+            && rangeAtoms[i + 2] != RANGE_MINUS) {
+            hi = rangeAtoms[i + 2];
+            i += 2;
         }
-        else if(strcmp(node->left->type,"UNICODE")==0){
-            unicode = 1;
-            if(strcmp(node->right->type,"MINUS") == 0){
-                long left;
-                sscanf(node->left->value, "%%x%lx;", &left);
-                minusEncountered = 1;
-                return (char)(int)left; 
-            }
-            else{
-                long left;
-                sscanf(node->left->value, "%%x%lx;", &left);
-                char buf[12];
-                sprintf(buf, "%d", (int)left); // convert left to string
-                addTransitionWithType(start, buf, TYPE_UNICODE, end);
-                if(strcmp(node->right->type,"UNICODE")==0){
-                    long i;
-                    sscanf(node->right->value, "%%x%lx;", &i);
-                    char buf[12];
-                    sprintf(buf, "%d", (int)i); // convert i to string
-                    addTransitionWithType(start, buf, TYPE_UNICODE, end);
-                }
-                
-                else{
-                    for (int i=0; i < strlen(node->right->value); ++i) { 
-                        char c = node->right->value[i];
-                        char buf[2] = { c, '\0' };
-                        addTransition(start, buf, end);
-                    }
-                }
-                return '\0';
-            }
+        if (lo > hi) { long t = lo; lo = hi; hi = t; }
+        r[n].lo = lo;
+        r[n++].hi = hi;
+    }
+
+    // sort and merge overlapping or adjacent intervals
+    qsort(r, n, sizeof(CodeRange), compareCodeRanges);
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (m > 0 && r[i].lo <= r[m - 1].hi + 1) {
+            if (r[i].hi > r[m - 1].hi) r[m - 1].hi = r[i].hi;
         }
-        else{ // when left is a final value, we add transition to end unless it has minus in right
-            for (int i=0; i < strlen(node->left->value)-1; ++i) {
-                char c = node->left->value[i];
-                char buf[2] = { c, '\0' };
-                addTransition(start, buf, end);
-            }
-            if(strcmp(node->right->type,"MINUS") == 0){
-                minusEncountered = 1;
-                return node->left->value[strlen(node->left->value) - 1]; // last character of left value
-            }
-            else{
-                char c = node->left->value[strlen(node->left->value) - 1];
-                char buf[2] = { c, '\0' };
-                addTransition(start, buf, end);
-                return '\0';
-            }
+        else r[m++] = r[i];
+    }
+
+    if (negate) { // the gaps between the intervals, at most one more than there are intervals
+        CodeRange *c = (CodeRange *)malloc((m + 1) * sizeof(CodeRange));
+        int k = 0;
+        long next = 0;
+        for (int i = 0; i < m; i++) {
+            if (r[i].lo > next) { c[k].lo = next; c[k++].hi = r[i].lo - 1; }
+            next = r[i].hi + 1;
+        }
+        if (next <= MAX_CODEPOINT) { c[k].lo = next; c[k++].hi = MAX_CODEPOINT; }
+        free(r);
+        r = c;
+        m = k;
+    }
+    *out = r;
+    return m;
+}
+
+int encodeUtf8(long cp, unsigned char *buf) {
+    if (cp < 0x80) { buf[0] = cp; return 1; }
+    if (cp < 0x800) { buf[0] = 0xc0 | (cp >> 6); buf[1] = 0x80 | (cp & 0x3f); return 2; }
+    if (cp < 0x10000) {
+        buf[0] = 0xe0 | (cp >> 12); buf[1] = 0x80 | ((cp >> 6) & 0x3f); buf[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    buf[0] = 0xf0 | (cp >> 18); buf[1] = 0x80 | ((cp >> 12) & 0x3f);
+    buf[2] = 0x80 | ((cp >> 6) & 0x3f); buf[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
+
+// Byte range edges already built inside the current class. Sequences sharing leading byte
+// ranges share their path too, so every state has at most one edge for a given byte, and
+// the last bytes of all sequences leading to the end state share one charset transition
+typedef struct Utf8Step {
+    State *from;
+    unsigned char lo;
+    unsigned char hi;
+    State *to;
+} Utf8Step;
+
+Utf8Step *stepCache = NULL;
+int stepCount = 0;
+int stepCap = 0;
+
+State* utf8Step(State *from, unsigned char lo, unsigned char hi) {
+    for (int i = 0; i < stepCount; i++)
+        if (stepCache[i].from == from && stepCache[i].lo == lo && stepCache[i].hi == hi)
+            return stepCache[i].to;
+    if (stepCount == stepCap) {
+        stepCap = stepCap ? stepCap * 2 : 16;
+        stepCache = (Utf8Step *)realloc(stepCache, stepCap * sizeof(Utf8Step));
+    }
+    State *to = createState(0);
+    addCharsetRange(from, lo, hi, to);
+    stepCache[stepCount].from = from;
+    stepCache[stepCount].lo = lo;
+    stepCache[stepCount].hi = hi;
+    stepCache[stepCount++].to = to;
+    return to;
+}
+
+// Split [lo, hi] until both ends encode to the same length and every byte but the first spans
+// whole continuation ranges; then the interval is exactly one sequence of byte ranges
+void addUtf8Ranges(long lo, long hi, State *start, State *end) {
+    if (lo > hi) return;
+    if (lo < 0xe000 && hi > 0xd7ff) { // surrogates have no encoding
+        addUtf8Ranges(lo, 0xd7ff, start, end);
+        addUtf8Ranges(0xe000, hi, start, end);
+        return;
+    }
+    static const long lengthMax[] = {0x7f, 0x7ff, 0xffff};
+    for (int i = 0; i < 3; i++) {
+        if (lo <= lengthMax[i] && hi > lengthMax[i]) {
+            addUtf8Ranges(lo, lengthMax[i], start, end);
+            addUtf8Ranges(lengthMax[i] + 1, hi, start, end);
+            return;
         }
     }
-    else{
-        if(strcmp(node->type,"UNICODE")==0){
-            long i;
-            sscanf(node->value, "%%x%lx;", &i);
-            char buf[12];
-            sprintf(buf, "%d", (int)i); // convert i to string
-            unicode = 1;
-            return (char)(int)i; // return the unicode value
-            // addTransitionWithType(start, buf, TYPE_UNICODE, end);
+    for (int i = 1; i < 4; i++) {
+        long m = (1L << (6 * i)) - 1; // the bits of the last i bytes
+        if ((lo & ~m) == (hi & ~m)) continue;
+        if ((lo & m) != 0) {
+            addUtf8Ranges(lo, lo | m, start, end);
+            addUtf8Ranges((lo | m) + 1, hi, start, end);
+            return;
         }
-        else{
-            unicode = 0;
-            for (int i=0; i < strlen(node->value)-1; ++i) { 
-                char c = node->value[i];
-                char buf[2] = { c, '\0' };
-                addTransition(start, buf, end);
-            }
-            return node->value[strlen(node->value) - 1]; // last character of left value
+        if ((hi & m) != m) {
+            addUtf8Ranges(lo, (hi & ~m) - 1, start, end);
+            addUtf8Ranges(hi & ~m, hi, start, end);
+            return;
         }
-        return '\0';
     }
+    unsigned char a[4], b[4];
+    int n = encodeUtf8(lo, a);
+    encodeUtf8(hi, b);
+    State *from = start;
+    for (int k = 0; k < n - 1; k++) from = utf8Step(from, a[k], b[k]);
+    addCharsetRange(from, a[n - 1], b[n - 1], end);
 }
 
-Transition* repeatFound= NULL;
-char repeatFoundChar = '\0'; // to store the character of the repeat found
-State *topSeq = NULL;
+void addCodeRanges(CodeRange *r, int n, State *start, State *end) {
+    stepCount = 0;
+    for (int i = 0; i < n; i++) addUtf8Ranges(r[i].lo, r[i].hi, start, end);
+}
 
-void addSequenceTransitions(ASTNode* node, State *start, State *end, State *L, State *R) {
-    if(!node) return;
+void addClassTransitions(ASTNode *node, int negate, State *start, State *end) {
+    CodeRange *r;
+    int n = classRanges(node, negate, &r);
+    addCodeRanges(r, n, start, end);
+    free(r);
+}
 
-    if(strcmp(node->type,"SEQ")==0){
-        if(strcmp(node->left->type,"REPEAT")==0){
-            if(strcmp(node->left->left->type,"WILD")==0){
-                char buf[20]={'\0'};
-                State *temp = R;
-                for(Transition *t = temp->transitions; t; t = t->next) {
-                    if(t->match){
-                        // printf("Matched: %s\n",t->match);
-                        strcpy(buf,t->match);
-                        break;
-                    }
-                }
-                // printf("buf:%s\n",buf);
-                
-                if(node->left->value[0] == '*'){
-                    addTransition(L->transitions->next->to->pair, buf, R->pair); // add transition from L->pair to end
-                    addTransitionReverse(L->transitions->next->to, buf, R->pair); // add transition from L->pair to end
-                }
-                else if(node->left->value[0] == '+'){
-                    addTransition(L->transitions->to->pair, buf, R->pair); // add transition from L->pair to end
-                }
-            }
+// The string a node made only of quoted text matches, or NULL when it can match anything else
+char* exactText(ASTNode *node, Symbol *symbolTable) {
+    if (node == NULL) return NULL;
+    switch (node->kind) {
+    case NODE_LITERAL:
+    case NODE_SEQ: {
+        char *l = exactText(node->left, symbolTable);
+        char *r = l ? exactText(node->right, symbolTable) : NULL;
+        char *s = NULL;
+        if (l && r) {
+            s = (char *)malloc(strlen(l) + strlen(r) + 1);
+            strcpy(s, l);
+            strcat(s, r);
         }
-        else{ // when repeat is in right or deeply rooted inside in right
-            if(strcmp(node->right->type,"REPEAT")==0){
-                if(strcmp(node->right->left->type,"WILD")==0){
-                    repeatFound = R->transitions; // return the pointer to wild so that we set it in outer SEQ
-                    repeatFoundChar = node->right->value[0]; // store the repeat character
-                }
+        free(l);
+        free(r);
+        return s;
+    }
+    case NODE_PAREN: return exactText(node->left, symbolTable);
+    case NODE_SUBSTITUTE: return exactText(getSymbol(node->left->value, symbolTable), symbolTable);
+    case NODE_UNICODE: {
+        unsigned char buf[5];
+        if (node->code == 0) return NULL; // NUL does not fit in a match string
+        buf[encodeUtf8(node->code, buf)] = '\0';
+        return strdup((char *)buf);
+    }
+    case NODE_RANGE: case NODE_NEGRANGE: case NODE_WILD: case NODE_REPEAT: case NODE_ALT:
+        return NULL;
+    default:
+        return node->value ? strdup(node->value) : NULL;
+    }
+}
+
+// Collect the branches of nested | (also through ( ) and ${ID}); 0 when one of them is not
+// plain text
+int literalBranches(ASTNode *node, Symbol *symbolTable, char ***words, int *count, int *cap) {
+    if (node == NULL) return 0;
+    if (node->kind == NODE_PAREN)
+        return literalBranches(node->left, symbolTable, words, count, cap);
+    if (node->kind == NODE_SUBSTITUTE)
+        return literalBranches(getSymbol(node->left->value, symbolTable), symbolTable, words, count, cap);
+    if (node->kind == NODE_ALT)
+        return literalBranches(node->left, symbolTable, words, count, cap)
+            && literalBranches(node->right, symbolTable, words, count, cap);
+    char *s = exactText(node, symbolTable);
+    if (s == NULL) return 0;
+    if (*count == *cap) {
+        *cap = *cap ? *cap * 2 : 16;
+        *words = (char **)realloc(*words, *cap * sizeof(char *));
+    }
+    (*words)[(*count)++] = s;
+    return 1;
+}
+
+// An alternation of plain strings becomes a trie from start to end: branches sharing a prefix
+// share its states, so the states active after each byte do not grow with the number of
+// branches. The whole input has to match, so no Aho-Corasick failure links are needed.
+// Returns 0 without building anything when a branch is not plain text.
+int addLiteralTrie(ASTNode *node, Symbol *symbolTable, State *start, State *end) {
+    char **words = NULL;
+    int count = 0, cap = 0;
+    int ok = literalBranches(node, symbolTable, &words, &count, &cap);
+    for (int w = 0; ok && w < count; w++) {
+        State *at = start;
+        for (const char *p = words[w]; *p; p++) {
+            Transition *t = at->transitions;
+            while (t && !(t->match && t->type == TYPE_DEFAULT && t->match[0] == *p && t->match[1] == '\0'))
+                t = t->next;
+            if (t == NULL) { // new branch of the trie
+                char buf[2] = { *p, '\0' };
+                State *next = createState(0);
+                addTransition(at, buf, next);
+                t = at->transitions;
             }
+            at = t->to;
         }
+        Transition *t = at->transitions;
+        while (t && !(t->match == NULL && t->to == end)) t = t->next;
+        if (t == NULL) addTransition(at, NULL, end); // the word ends here
     }
+    for (int w = 0; w < count; w++) free(words[w]);
+    free(words);
+    return ok;
 }
 
 State* generateStates(ASTNode* node, Symbol *symbolTable) {
@@ -520,7 +608,9 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
     end->pair = start; // pair the end and start states
 
     // 1) Alternation:  ALT ← left | right
-    if (strcmp(node->type, "ALT") == 0) {
+    switch (node->kind) {
+    case NODE_ALT: {
+        if (addLiteralTrie(node, symbolTable, start, end)) return start; // only quoted text
         State* L = generateStates(node->left,symbolTable);
         State* R = generateStates(node->right,symbolTable);
         addTransition(start, NULL, L);
@@ -530,35 +620,17 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         return start;
     }
     // 2) Sequence: SEQ ← left · right
-    else if (strcmp(node->type, "SEQ") == 0) {
-        //special case with wildcard repeat issue
-        if(!topSeq) {
-            topSeq = start; // set the top sequence state
-        }
+    case NODE_SEQ: {
         State* L = generateStates(node->left,symbolTable);
         State* R = generateStates(node->right,symbolTable);
         addTransition(start,    NULL, L);
         addTransition(L->pair,  NULL, R);
         addTransition(R->pair,  NULL, end);
         start->node = node;
-
-        addSequenceTransitions(node, start, end,L,R); 
-        if(repeatFound != NULL && topSeq == start){ // i.e. if in some inner SEQ, repeat>wild was found
-            topSeq = NULL; // reset the top sequence state
-            if(repeatFoundChar == '*'){
-                addTransition(repeatFound->next->to->pair, node->right->value, R->pair); 
-                addTransitionReverse(repeatFound->next->to, node->right->value, R->pair); 
-            }
-            else if(repeatFoundChar == '+'){
-                addTransition(repeatFound->to->pair, node->right->value, R->pair); 
-            }
-            repeatFound = NULL; // reset the repeat found pointer
-            repeatFoundChar = '\0'; // reset the repeat found character
-        }
         return start;
     }
     // 3) Repetition: REPEAT ← child  with operator in node->value (“*”, “+”, or “?”)
-    else if (strcmp(node->type, "REPEAT") == 0) {
+    case NODE_REPEAT: {
         char op = node->value[0];
         State* F = generateStates(node->left,symbolTable);
         if (op == '*') {
@@ -581,36 +653,28 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         return start;
     }
     // 4) Parentheses: PAREN ← ( child )
-    else if (strcmp(node->type, "PAREN") == 0) {
+    case NODE_PAREN: {
         State* C = generateStates(node->left,symbolTable);
         addTransition(start,   NULL, C);
         addTransition(C->pair, NULL, end);
         return start;
     }
-     // 5) Character class: RANGE ← [ ... ]
-    else if (strcmp(node->type, "RANGE") == 0) {
-        char c =addRangeTransitions(node->left, start, end); // add range transitions
-        if (c != '\0' && c != '\n') {
-            char buf[2] = { c, '\0' };
-            addTransition(start, buf, end); // add transition for the last character
-        }
-        if(minusEncountered){
-            addTransition(start, "-", end); // add transition for the last character
-            minusEncountered=0;
-        }
-        unicode=0;
+     // 5) Character class: RANGE ← [ ... ], NEGRANGE ← [^ ... ]
+    case NODE_RANGE:
+    case NODE_NEGRANGE: {
+        addClassTransitions(node->left, node->kind == NODE_NEGRANGE, start, end);
         return start;
     }
-    else if (strcmp(node->type, "NEGRANGE") == 0) {
-        State *sink = createState(0);
-        addRangeTransitions(node->left, start, sink);
-        addTransitionWithType(start, ".", TYPE_WILDCARD, end);
-        // addRangeTransitions(node->left, start, end,1);
+    // 6) Unicode escape %xHH; outside a class: the UTF-8 bytes of that code point
+    case NODE_UNICODE: {
+        CodeRange r;
+        r.lo = r.hi = node->code;
+        addCodeRanges(&r, 1, start, end);
         return start;
     }
     // 7) Substitute: SUBSTITUTE ← ${ ID }
     //    (you’ll want to replace this by expanding the ID’s definition AST)
-    else if (strcmp(node->type, "SUBSTITUTE") == 0) {
+    case NODE_SUBSTITUTE: {
         // for now treat as literal match of the name
         // node->left is the ASTNode("ID", name)
         ASTNode *symNode = getSymbol(node->left->value, symbolTable); // get the symbol from the symbol table
@@ -624,12 +688,12 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         return start;
     }
     // 8) Wildcard: WILD ← “.”
-    else if (strcmp(node->type, "WILD") == 0) {
-        addTransitionWithType(start, ".",TYPE_WILDCARD, end);
+    case NODE_WILD: {
+        addCharsetRange(start, 0, 255, end);
         start->node = node;
         return start;
     }
-    else if(strcmp(node->type, "LITERAL") == 0) {
+    case NODE_LITERAL: {
         State* left_state = generateStates(node->left,symbolTable);
         addTransition(start, NULL, left_state); // Transition for literal
         
@@ -638,13 +702,13 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         addTransition(right_state->pair, NULL, end); // Transition to end state
         return start;
     }
-    else if(strcmp(node->type, "SYSTEM") == 0) {
+    case NODE_SYSTEM: {
         State *R = generateStates(node->right,symbolTable); // get the right node
         addTransition(start, NULL, R);
         addTransition(R->pair, NULL, end); // Transition to end state
         return start;
     }
-    else if(strcmp(node->type, "CONCAT") == 0) {
+    case NODE_CONCAT: {
         State *L = generateStates(node->left,  symbolTable);
         State *R = generateStates(node->right, symbolTable);
         if (startCount + 2 <= MAX_SUBNFAS) {
@@ -661,7 +725,7 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         }
         return NULL;
     }
-    else if(strcmp(node->type, "NOTREGEX") == 0){
+    case NODE_NOTREGEX: {
         State *inner = generateStates(node->left,symbolTable); // get the left node
         if(startCount+1 <=MAX_SUBNFAS){
             startStates[startCount] = inner; // add the inner state to the list of start states
@@ -670,18 +734,11 @@ State* generateStates(ASTNode* node, Symbol *symbolTable) {
         }
         return NULL;
     }
-    // else if(strcmp(node->type, "ID") == 0 || strcmp(node->type, "PLUS") == 0 || strcmp(node->type, "MINUS") == 0 || strcmp(node->type, "RBIG") == 0 
-    //         || strcmp(node->type, "CONST") == 0 || strcmp(node->type, "EQUAL") == 0 || strcmp(node->type, "AMP") == 0 || strcmp(node->type, "NOT") == 0
-    //         || strcmp(node->type, "LPAR") == 0 || strcmp(node->type, "RPAR") == 0 || strcmp(node->type, "PIPE") == 0 || strcmp(node->type, "QUES") == 0
-    //         || strcmp(node->type, "LBIG") == 0 || strcmp(node->type, "ESC") == 0 || strcmp(node->type, "ASTRK") == 0 || strcmp(node->type, "DOT") == 0
-    //         || strcmp(node->type, "LCUR") == 0 || strcmp(node->type, "RCUR") == 0 || strcmp(node->type, "OTHERS") == 0 || strcmp(node->type, "UNICODE") == 0
-    //         ) 
-    else
-        {
-        addTransition(start, node->value, end); // Start to end connected through the string value
+    default: { // single characters and quoted text: start to end connected through the string value
+        addTransition(start, node->value, end);
         return start;
     }
-    return start;
+    }
 }
 
 void reorderWildcards() {
@@ -691,7 +748,7 @@ void reorderWildcards() {
 
         // Split into two lists, preserving the original relative order
         for (Transition *t = s->transitions; t; t = t->next) {
-            if (t->type == TYPE_WILDCARD) {
+            if (t->type == TYPE_CHARSET) {
                 if (!wildHead) wildHead = wildTail = t;
                 else {
                     wildTail->next = t;
@@ -720,9 +777,64 @@ void reorderWildcards() {
     }
 }
 
+#include "Literal.h" // required literal prefilter
+
+#include "Driver.h" // input handling shared with the generic runner
+
+// main() of every single pattern backend. They all provide match_stream(FILE *), which reads one
+// whole input, and match_record(buf, len), which matches one record already in memory. Backends
+// whose match_record() touches no global state define REENTRANT_MATCH, so many files can be
+// matched by a pool of threads.
+void mainCode(FILE *file, int needsSetup) {
+    int filtered = hasPrefilter();
+    if (filtered) prefilterCode(file);
+    verdictCode(file, filtered);
+    driverCode(file);
+    fprintf(file,
+        "\n"
+        "int main(int argc, char **argv) {\n"
+        "%s"
+        "    return run_inputs(argc, argv);\n"
+        "}\n",
+        needsSetup ? "    setup();\n" : ""
+    );
+}
+
+#include "Automaton.h" // binary automaton file layout
+#include "DFA.h" // subset construction backend
+#include "Lazy.h" // on demand determinization backend
+#include "BitParallel.h" // single word frontier for small patterns
+#include "Library.h" // reentrant matcher library output
+#include "Match.h" // in process matching without a C compiler
+#include "Cache.h" // content addressed cache of generated files
+#include "Set.h" // many patterns in one DFA
+
+// Epsilon closure of s in the order the runtime visits it: depth first, following epsilon
+// transitions in runtime order. setup() prepends while walking our list, so the runtime order
+// is the reverse of s->transitions and pushing in list order pops in runtime order.
+int closureOf(State *s, State **out, State **stack, int *seen, int stamp) {
+    int count = 0, top = 0;
+    stack[top++] = s;
+    while (top > 0) {
+        State *c = stack[--top];
+        if (seen[c->id] == stamp) continue; // already part of the closure
+        seen[c->id] = stamp;
+        out[count++] = c;
+        for (Transition *t = c->transitions; t; t = t->next) {
+            if (t->match == NULL && seen[t->to->id] != stamp)
+                stack[top++] = t->to;
+        }
+    }
+    return count;
+}
+
 void headerCode(FILE *file); // forward declaration
 
 void generateParseCode(ASTNode *node, FILE *file, Symbol *symbolTable) {
+    if(!matchPath){
+        hashPattern(node, symbolTable);
+        if(cachedOutput()) return; // built before with the same pattern and options
+    }
 
     State *start = generateStates(node,symbolTable);
     if(startCount == 0 && start){
@@ -730,10 +842,58 @@ void generateParseCode(ASTNode *node, FILE *file, Symbol *symbolTable) {
         start->pair->is_accept = 1; // set the end state as accept state
     }
     // reorderWildcards(); // reorder the wildcards in the state machine
-    headerCode(file); 
+    findLiterals(node, symbolTable);
+    if(matchPath){ // no code is written, the input is matched right here
+        int m = matchInProcess(matchPath);
+        if(m >= 0) printf("%s\n", m ? "ACCEPTS" : "REJECTS");
+        else matchFailed = 1;
+    }
+    else if(genMode == GEN_DFA || genMode == GEN_GOTO){
+        dfaCode(file);
+    }
+    else if(genMode == GEN_LAZY){
+        lazyCode(file);
+    }
+    else if(genMode == GEN_LIB){
+        libraryCode(file, libHeader);
+    }
+    else if(genMode == GEN_SAVE){
+        saveAutomaton(file);
+    }
+    else if(!bitParallel){ // --nfa
+        headerCode(file); 
+    }
+    else if(!bitParallelCode(file)){ // too many positions for one word
+        lazyCode(file);
+    }
+    if(!matchPath) storeOutput();
+    freeLiterals();
+}
+
+// Turn every transition matching a string of several bytes into a chain of one byte
+// transitions, so the runner moves all active states forward one byte at a time
+void splitMatchStrings() {
+    for (State *s = all_states; s; s = s->next) { // new states go in front, they are not visited
+        for (Transition *t = s->transitions; t; t = t->next) {
+            if (!t->match || t->type != TYPE_DEFAULT || strlen(t->match) < 2) continue;
+            State *to = t->to;
+            char *rest = t->match + 1;
+            char first[2] = { t->match[0], '\0' };
+            t->match = arenaStrdup(&nfaArena, first);
+            t->to = createState(0);
+            for (State *at = t->to; *rest; rest++) {
+                char c[2] = { *rest, '\0' };
+                State *next = rest[1] ? createState(0) : to;
+                addTransition(at, c, next);
+                at = next;
+            }
+        }
+    }
 }
 
 void headerCode(FILE *file) {
+    splitMatchStrings();
+
     // 1) Include + struct definitions
     fprintf(file,
         "#include <stdio.h>\n"
@@ -746,11 +906,14 @@ void headerCode(FILE *file) {
         "    State *to;\n"
         "    int type;\n"
         "    Transition *next;\n"
+        "    const unsigned char *set;\n"
         "};\n\n"
         "struct State {\n"
         "    int id;\n"
         "    int is_accept;\n"
         "    Transition *transitions;\n"
+        "    State **closure;\n"
+        "    int closure_count;\n"
         "};\n\n"
     );
 
@@ -761,20 +924,71 @@ void headerCode(FILE *file) {
     }
     fprintf(file, "\n");
 
-    // 3) Declare Transition variables
+    // 3) Declare the charset bitmaps, each distinct one once, then the Transition variables
+    int setCount = 0, setCap = 16;
+    unsigned char **sets = (unsigned char **)malloc(setCap * sizeof(unsigned char *));
     for (State *s = all_states; s; s = s->next) {
         for (Transition *t = s->transitions; t; t = t->next) {
-            if (t->match)
+            if (t->set == NULL) continue;
+            int k = 0;
+            while (k < setCount && memcmp(sets[k], t->set, 32) != 0) k++;
+            if (k < setCount) continue;
+            if (setCount == setCap) {
+                setCap *= 2;
+                sets = (unsigned char **)realloc(sets, setCap * sizeof(unsigned char *));
+            }
+            sets[setCount++] = t->set;
+            fprintf(file, "const unsigned char cs%d[32] = {", k);
+            for (int b = 0; b < 32; b++) fprintf(file, "0x%02x%s", t->set[b], (b + 1 < 32 ? "," : ""));
+            fprintf(file, "};\n");
+        }
+    }
+    // transitions are named by their state and position in its list, so the same pattern
+    // always gives the same text
+    for (State *s = all_states; s; s = s->next) {
+        int n = 0;
+        for (Transition *t = s->transitions; t; t = t->next, n++) {
+            if (t->set) {
+                int k = 0;
+                while (memcmp(sets[k], t->set, 32) != 0) k++;
+                fprintf(file,
+                    "Transition t_%d_%d = { \"\", &s%d, %d, NULL, cs%d };\n",
+                    s->id, n, t->to->id, t->type, k);
+            }
+            else if (t->match)
                 fprintf(file,
-                    "Transition t_%d_%p = { \"%s\", &s%d, %d, NULL };\n",
-                    s->id, (void*)t, t->match, t->to->id, t->type);
+                    "Transition t_%d_%d = { \"%s\", &s%d, %d, NULL, NULL };\n",
+                    s->id, n, t->match, t->to->id, t->type);
             else
                 fprintf(file,
-                    "Transition t_%d_%p = { NULL, &s%d, %d, NULL };\n",
-                    s->id, (void*)t, t->to->id, t->type);
+                    "Transition t_%d_%d = { NULL, &s%d, %d, NULL, NULL };\n",
+                    s->id, n, t->to->id, t->type);
         }
     }
     fprintf(file, "\n");
+    free(sets);
+
+    // 3b) Precomputed epsilon closure of every state, computed once here with a worklist
+    int edgeCount = 1;
+    for (State *s = all_states; s; s = s->next)
+        for (Transition *t = s->transitions; t; t = t->next) edgeCount++;
+    State **closure = (State **)malloc(state_id * sizeof(State *));
+    State **stack = (State **)malloc(edgeCount * sizeof(State *));
+    int *seen = (int *)calloc(state_id, sizeof(int));
+    int *closureCount = (int *)calloc(state_id, sizeof(int));
+    int stamp = 0;
+    for (State *s = all_states; s; s = s->next) {
+        int n = closureOf(s, closure, stack, seen, ++stamp);
+        closureCount[s->id] = n;
+        fprintf(file, "State *c%d[%d] = {", s->id, n);
+        for (int k = 0; k < n; k++)
+            fprintf(file, "&s%d%s", closure[k]->id, (k + 1 < n ? ", " : ""));
+        fprintf(file, "};\n");
+    }
+    fprintf(file, "\n");
+    free(closure);
+    free(stack);
+    free(seen);
 
 
     fprintf(file,
@@ -808,120 +1022,173 @@ void headerCode(FILE *file) {
         fprintf(file,
             "    s%d.id = %d;\n"
             "    s%d.is_accept = %d;\n"
-            "    s%d.transitions = NULL;\n",
+            "    s%d.transitions = NULL;\n"
+            "    s%d.closure = c%d;\n"
+            "    s%d.closure_count = %d;\n",
             s->id, s->id,
             s->id, s->is_accept,
-            s->id
+            s->id,
+            s->id, s->id,
+            s->id, closureCount[s->id]
         );
-        for (Transition *t = s->transitions; t; t = t->next) {
+        int n = 0;
+        for (Transition *t = s->transitions; t; t = t->next, n++) {
             fprintf(file,
-                "    t_%d_%p.next = s%d.transitions;\n"
-                "    s%d.transitions = &t_%d_%p;\n",
-                s->id, (void*)t, s->id,
+                "    t_%d_%d.next = s%d.transitions;\n"
+                "    s%d.transitions = &t_%d_%d;\n",
+                s->id, n, s->id,
                 s->id,
-                s->id, (void*)t
+                s->id, n
             );
         }
     }
     fprintf(file, "}\n\n");
+    free(closureCount);
 
-    // 5) NFA runner: single‐pass step() + match()
+    // 5) NFA runner: single‐pass step() over a sliding window of the input
+    fprintf(file, "#define NUM_STATES %d // frontier capacity, one slot per state id\n", state_id);
+    fprintf(file, "#define MAX_MATCH 1 // lookahead a single step may need, every transition takes one byte\n");
+    fprintf(file, "#define CHUNK_SIZE 65536 // bytes read from the input at a time\n\n");
     fprintf(file,
-        "// active states frontier\n"
-        "State *state_list[1024];\n"
-        "int state_count;\n\n"
-
-        "// add a state to a list if not already present\n"
-        "void add_state_to(State **list, int *count, State *s) {\n"
-        "    for (int i = 0; i < *count; ++i)\n"
-        "        if (list[i] == s) return;\n"
-        "    list[(*count)++] = s;\n"
+        "// active states frontier: Briggs-Torczon sparse sets indexed by state id\n"
+        "typedef struct StateSet {\n"
+        "    State *dense[NUM_STATES];  // members in insertion order\n"
+        "    int sparse[NUM_STATES];    // slot of each member in dense\n"
+        "    int count;\n"
+        "} StateSet;\n\n"
+
+        "// one simulation per sub regex of & and !, each with its own frontier and window position\n"
+        "typedef struct Matcher {\n"
+        "    StateSet sets[2];\n"
+        "    StateSet *state_list;\n"
+        "    StateSet *next_states;\n"
+        "    long pos;    // next unread byte of the window\n"
+        "    int failed;  // no transition could consume the input\n"
+        "} Matcher;\n\n"
+
+        "// O(1) membership: s is present only if its slot points back at it\n"
+        "int set_contains(StateSet *set, State *s) {\n"
+        "    int k = set->sparse[s->id];\n"
+        "    return k < set->count && set->dense[k] == s;\n"
         "}\n\n"
 
-        "// epsilon‐closure into an arbitrary list\n"
-        "void add_epsilon_closure_to(State *s, State **list, int *count) {\n"
-        "    add_state_to(list, count, s);\n"
-        "    for (Transition *t = s->transitions; t; t = t->next) {\n"
-        "        if (t->match == NULL)\n"
-        "            add_epsilon_closure_to(t->to, list, count);\n"
-        "    }\n"
+        "// add a state to a set if not already present\n"
+        "void add_state_to(StateSet *set, State *s) {\n"
+        "    if (set_contains(set, s)) return;\n"
+        "    set->sparse[s->id] = set->count;\n"
+        "    set->dense[set->count++] = s;\n"
         "}\n\n"
 
-        "// consume exactly one chunk from input[*i] and build next_states\n"
-        "int step(const char *input, int *i, int len) {\n"
-        "    State *next_states[1024];\n"
-        "    int next_count = 0;\n"
-        "    int consumed = 0;\n\n"
+        "// union the precomputed epsilon closure of s into an arbitrary set\n"
+        "void add_epsilon_closure_to(State *s, StateSet *set) {\n"
+        "    for (int k = 0; k < s->closure_count; ++k)\n"
+        "        add_state_to(set, s->closure[k]);\n"
+        "}\n\n"
+
+        "// consume input[*i]: every active state follows every transition accepting that byte\n"
+        "int step(Matcher *mt, const char *input, long *i, long len) {\n"
+        "    StateSet *next_states = mt->next_states;\n"
+        "    next_states->count = 0; // O(1) clear\n"
+        "    if (*i >= len) return 0;\n"
+        "    unsigned char c = input[*i];\n\n"
         "    // For each currently active state\n"
-        "    for (int si = 0; si < state_count && !consumed; ++si) {\n"
-        "        State *s = state_list[si];\n"
-        "        for (Transition *t = s->transitions; t && !consumed; t = t->next) {\n"
+        "    for (int si = 0; si < mt->state_list->count; ++si) {\n"
+        "        State *s = mt->state_list->dense[si];\n"
+        "        for (Transition *t = s->transitions; t; t = t->next) {\n"
         "            if (!t->match) continue;\n"
-        "            if (t->type == 1) {\n"
-        "                // wildcard: any single char\n"
-        "                if (*i < len) {\n"
-        "                    consumed = 1;\n"
-        "                    add_epsilon_closure_to(t->to, next_states, &next_count);\n"
-        "                }\n"
-        "            } else if (t->type == 2) {\n"
-        "                // validate unicode of given char\n"
-        "                if (input[*i] == (char)atoi(t->match)) {\n"
-        "                    consumed = 1;\n"
-        "                    add_epsilon_closure_to(t->to, next_states, &next_count);\n"
-        "                }\n"
-        "            } else {\n"
-        "                int m = strlen(t->match);\n"
-        "                if (*i + m <= len && strncmp(input + *i, t->match, m) == 0) {\n"
-        "                    consumed = m;\n"
-        "                    add_epsilon_closure_to(t->to, next_states, &next_count);\n"
-        "                }\n"
-        "            }\n"
+        "            if (t->type == 1 ? (t->set[c >> 3] >> (c & 7)) & 1 // charset: one bit probe\n"
+        "                : t->match[0] != '\\0' && (unsigned char)t->match[0] == c)\n"
+        "                add_epsilon_closure_to(t->to, next_states);\n"
         "        }\n"
         "    }\n\n"
-        "    if (!consumed) return 0;\n\n"
-        "    // Commit next_states → state_list\n"
-        "    state_count = next_count;\n"
-        "    memcpy(state_list, next_states, next_count * sizeof(State *));\n"
-        "    *i += consumed;\n"
-        "    return consumed;\n"
+        "    if (next_states->count == 0) return 0;\n\n"
+        "    // Commit next_states → state_list by swapping the two sets\n"
+        "    mt->next_states = mt->state_list;\n"
+        "    mt->state_list = next_states;\n"
+        "    *i += 1;\n"
+        "    return 1;\n"
+        "}\n\n"
+
+        "// begin a simulation at the epsilon closure of start\n"
+        "void start_matcher(Matcher *mt, State *start) {\n"
+        "    mt->state_list = &mt->sets[0];\n"
+        "    mt->next_states = &mt->sets[1];\n"
+        "    mt->state_list->count = 0;\n"
+        "    add_epsilon_closure_to(start, mt->state_list);\n"
+        "    mt->pos = 0;\n"
+        "    mt->failed = 0;\n"
         "}\n\n"
 
-        "// Run the matcher in exactly one pass over the input\n"
-        "int match(const char *input, State *start) {\n"
-        "    int len = strlen(input);\n"
-        "    state_count = 0;\n"
-        "    add_epsilon_closure_to(start, state_list, &state_count);\n"
-        "    int i = 0;\n"
-        "    while (i < len) {\n"
-        "        if (!step(input, &i, len)) return 0;\n"
+        "// step through the window; unless the input ended, stop MAX_MATCH bytes short of its end\n"
+        "// so a multi byte transition never sees a match cut by the chunk boundary\n"
+        "void feed(Matcher *mt, const char *input, long len, int at_eof) {\n"
+        "    while (!mt->failed && mt->pos < len && (at_eof || len - mt->pos >= MAX_MATCH)) {\n"
+        "        if (!step(mt, input, &mt->pos, len)) mt->failed = 1;\n"
         "    }\n"
-        "    // Accept if any remaining state is accepting\n"
-        "    for (int si = 0; si < state_count; ++si){\n"
-        "        if (state_list[si]->is_accept == 1) return 1;\n"
+        "}\n\n"
+
+        "// Accept if any remaining state is accepting\n"
+        "int is_accepting(Matcher *mt) {\n"
+        "    if (mt->failed) return 0;\n"
+        "    for (int si = 0; si < mt->state_list->count; ++si){\n"
+        "        if (mt->state_list->dense[si]->is_accept == 1) return 1;\n"
         "    }\n"
         "    return 0;\n"
         "}\n\n"
     );
 
+    // 6) stream the file (or stdin) through every matcher in one pass, constant memory
     fprintf(file,
-        "int main(int argc, char **argv) {\n"
-        "    if (argc < 2) { fprintf(stderr, \"Usage: %%s <file>\\n\", argv[0]); return 1; }\n"
-        "    setup();\n"
-        "    FILE *f = fopen(argv[1], \"r\"); if (!f) { perror(\"fopen\"); return 1; }\n"
-        "    fseek(f, 0, SEEK_END); long len = ftell(f);\n"
-        "    fseek(f, 0, SEEK_SET);\n"
-        "    char *buf = malloc(len + 1);\n"
-        "    fread(buf, 1, len, f);\n"
-        "    buf[len] = '\\0'; fclose(f);\n"
-        "    int result = 1;\n"
-        "    for (int i = 0; i < %d; i++) {\n"
-        "        int m = match(buf, startStates[i]);\n"
+        "static Matcher matchers[%d];\n\n"
+
+        "// a failed matcher never recovers, so the verdict is fixed once a non inverted one failed\n"
+        "// or all of them did, and the rest of the input need not be read\n"
+        "int settled(void) {\n"
+        "    int open = 0;\n"
+        "    for (int k = 0; k < startCount; k++) {\n"
+        "        if (!matchers[k].failed) { open = 1; continue; }\n"
+        "        if (!invertFlags[k]) return 1;\n"
+        "    }\n"
+        "    return !open;\n"
+        "}\n\n"
+
+        "int match_stream(FILE *f) {\n"
+        "    static char buf[CHUNK_SIZE + MAX_MATCH];\n"
+        "    for (int k = 0; k < startCount; k++) start_matcher(&matchers[k], startStates[k]);\n"
+        "    long len = 0;\n"
+        "    int at_eof = 0;\n"
+        "    while (!at_eof && !settled()) {\n"
+        "        // drop what every live matcher has consumed, then refill the window\n"
+        "        long keep = len;\n"
+        "        for (int k = 0; k < startCount; k++)\n"
+        "            if (!matchers[k].failed && matchers[k].pos < keep) keep = matchers[k].pos;\n"
+        "        memmove(buf, buf + keep, len - keep);\n"
+        "        len -= keep;\n"
+        "        for (int k = 0; k < startCount; k++) matchers[k].pos -= keep;\n"
+        "        size_t n = fread(buf + len, 1, sizeof(buf) - len, f);\n"
+        "        len += n;\n"
+        "        at_eof = n == 0;\n"
+        "        for (int k = 0; k < startCount; k++) feed(&matchers[k], buf, len, at_eof);\n"
+        "    }\n"
+        "    for (int i = 0; i < startCount; i++) {\n"
+        "        int m = is_accepting(&matchers[i]);\n"
         "        if (invertFlags[i]) m = !m;\n"
-        "        if (!m) { result = 0; break; }\n"
+        "        if (!m) return 0;\n"
         "    }\n"
-        "    if (result) printf(\"ACCEPTS\\n\"); else printf(\"REJECTS\\n\");\n"
-        "    free(buf);\n"
-        "    return 0;\n"
-        "}\n",
+        "    return 1;\n"
+        "}\n\n"
+
+        "// a record is a whole input on its own, so every matcher sees its end right away\n"
+        "int match_record(const unsigned char *input, long len) {\n"
+        "    for (int i = 0; i < startCount; i++) {\n"
+        "        start_matcher(&matchers[i], startStates[i]);\n"
+        "        feed(&matchers[i], (const char *)input, len, 1);\n"
+        "        int m = is_accepting(&matchers[i]);\n"
+        "        if (invertFlags[i]) m = !m;\n"
+        "        if (!m) return 0;\n"
+        "    }\n"
+        "    return 1;\n"
+        "}\n\n",
         startCount);
+    mainCode(file, 1);
 }
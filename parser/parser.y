@@ -26,9 +26,6 @@ extern FILE *yyin;
 
 FILE *out_c_file;
 
-#define MAX_SUBNFAS 100 // maximum number of sub NFAs
-State *existing_states[MAX_SUBNFAS*1024];
-
 //custom error message
 struct errorCode{
     int code;
@@ -46,7 +43,8 @@ struct errorCode code[] = {
     {5, "Unicode escape out of range"},
     {6, "Error using const format or missing SLASH"},
     {7, "Invalid range format with unicode"},
-    {8, "Duplicate definition of identifier"}
+    {8, "Duplicate definition of identifier"},
+    {9, "Identifier defined in terms of itself"}
 }; // couldn't fix this to show different codes due to R/R conflict. So, use last for default as of now
 
 // Error handling
@@ -61,10 +59,6 @@ Symbol *unknownSymbol = NULL; // declare unknown symbol to be empty
 
 ASTNode *leftMinus = NULL; // to store the node to left of minus in range []
 int minusflag = 0; // flag to check if minus is used in range
-int stop_free = 0; 
-
-int symbolCount = 0; 
-ASTNode *tempholder[1024];
 
 %}
 
@@ -96,35 +90,33 @@ ASTNode *tempholder[1024];
 /*To support multiple tests in file
  a single line or multiple line */
 line: system {
+        if(recursiveSymbol($1, symbolTable)){ // ${ } cycles have no finite expansion
+            yyerror(code[9].msg);
+            return 1;
+        }
         if(debugging){ // print the Abstract Syntax Tree for debugging
             printf("%d:\n",lineCount); 
             printAST($1,0); // print the AST
         }
-        generateParseCode($1,out_c_file, symbolTable); // generate the parse code for the AST
-        freeStates(existing_states); // free the states in the startStates array
-        if(!stop_free){
-            freeAST($1); // free the AST
+        if(setMode){ // the first pattern of the set, the code comes once the file is read
+            if(!addSetPattern($1, symbolTable)) return 1;
         }
         else{
-            tempholder[symbolCount] = $1; // store the AST in a temporary holder to free later
-            symbolCount++; // increase the symbol count to keep track of how many ASTs are stored
-            stop_free = 0; // reset the stop_free flag
+            generateParseCode($1,out_c_file, symbolTable); // generate the parse code for the AST
+            releaseStates(); // drop the NFA, the AST stays in astArena until cleanUp()
         }
     }
     | line system {
         lineCount++; //increase linecount everytime we read a new line
+        if(recursiveSymbol($2, symbolTable)){
+            yyerror(code[9].msg);
+            return 1;
+        }
         if(debugging){ // print the Abstract Syntax Tree for debugging
             printf("%d:\n",lineCount); 
             printAST($2,0);
         }
-        if(!stop_free){
-            freeAST($2); // free the AST
-        }
-        else{
-            tempholder[symbolCount] = $2; // store the AST in a temporary holder to free later
-            symbolCount++; // increase the symbol count to keep track of how many ASTs are stored
-            stop_free = 0; // reset the stop_free flag
-        }
+        if(setMode && !addSetPattern($2, symbolTable)) return 1; // one more pattern of the set
     }
     | error { 
         yyerror(code[1].msg); 
@@ -134,11 +126,11 @@ line: system {
 
 // System     := Definition* '/' RootRegex '/'
 system: SLASH rootregex SLASH { // the case of no definition and regex in form / RootRegex /
-        // $$ = createNode("SYSTEM",NULL,$2,NULL); // create a regex start
+        // $$ = createNode(NODE_SYSTEM,NULL,$2,NULL); // create a regex start
         $$ = $2;
     } 
     | definition system{ // for one or more definition i.e. const ID = / regex / / RootRegex /
-        $$ = createNode("SYSTEM",NULL,$1,$2); // create a regex start
+        $$ = createNode(NODE_SYSTEM,NULL,$1,$2); // create a regex start
     }; 
 
 definition: CONST_TOK ID EQUAL SLASH regex SLASH{ // definition in the form of "const ID = /regex/"
@@ -150,18 +142,16 @@ definition: CONST_TOK ID EQUAL SLASH regex SLASH{ // definition in the form of "
         // Insert ID to symbol table and pass by reference to update global
         insertSymbol($2,$5,&symbolTable); 
 
-        stop_free = 1;
-
-        ASTNode *id= createNode("ID",$2,NULL,NULL); // create a node for ID
-        $$ = createNode("DEFINITION",NULL,id,$5); // create DEFINITION node with id as value
+        ASTNode *id= createNode(NODE_ID,$2,NULL,NULL); // create a node for ID
+        $$ = createNode(NODE_DEFINITION,NULL,id,$5); // create DEFINITION node with id as value
         free($2); // free the ID as it is already stored in symbol table
     };
 
 rootregex: rootregex AMP rootregex { // For RootRegex = RootRegex & RootRegex
-        $$ = createNode("CONCAT", "&", $1, $3); // amp node
+        $$ = createNode(NODE_CONCAT, "&", $1, $3); // amp node
     }
     | NOT alt { // For RootRegex = ! Regex (used alt to match precedence)
-        $$ = createNode("NOTREGEX", "!", $2, NULL);
+        $$ = createNode(NODE_NOTREGEX, "!", $2, NULL);
     }
     | alt { // For RootRegex = Regex (used alt to match precedence)
         // $$ = createNode("ROOTREGEX", NULL, $1, NULL);
@@ -174,7 +164,7 @@ alt: seq { // For Regex = seq, kept here to match precedence of seq over alt
     | alt PIPE seq { /* For alt = Regex | Regex, where we group the first(alt) and second(seq) before |
         Here, alt PIPE is done for multiple PIPE in sequence and seq represents one or more regex
          since seq has higher precedence than alt */
-        $$ = createNode("ALT", $2, $1, $3);
+        $$ = createNode(NODE_ALT, $2, $1, $3);
     };
 
 //For Regex = seq
@@ -182,7 +172,7 @@ seq: regex { // For only one Regex
         $$ = $1;
     }
     | seq regex { // For more than one regex
-        $$ = createNode("SEQ", NULL, $1, $2);
+        $$ = createNode(NODE_SEQ, NULL, $1, $2);
     };
 
 regex: term { // For Regex = term
@@ -191,7 +181,7 @@ regex: term { // For Regex = term
         clearYylval();
     } 
     | LPAR alt RPAR { // For Regex = ( Regex ), used alt because alt is the highest level making ( ) higher precedence
-        $$ = createNode("PAREN","()",$2,NULL);
+        $$ = createNode(NODE_PAREN,"()",$2,NULL);
     }
     | repeat { // Regex = repeat (always has higher precedence than seq)
         $$ = $1;
@@ -199,13 +189,13 @@ regex: term { // For Regex = term
 
 // Three cases of repeat with *, + and ?
 repeat: regex ASTRK { 
-        $$ = createNode("REPEAT", "*", $1, NULL);
+        $$ = createNode(NODE_REPEAT, "*", $1, NULL);
     }
     | regex PLUS { 
-        $$ = createNode("REPEAT", "+", $1, NULL);
+        $$ = createNode(NODE_REPEAT, "+", $1, NULL);
     }
     | regex QUES { 
-        $$ = createNode("REPEAT", "?", $1, NULL);
+        $$ = createNode(NODE_REPEAT, "?", $1, NULL);
     };
 
 // term = literal | range | wild | substitute
@@ -224,70 +214,65 @@ term: QUOTE multiliteral QUOTE { // For term = literal (used multiliteral to han
         if (!checkSymbol($1->value,symbolTable) && !checkSymbol($1->value,unknownSymbol)) { // check if the ID is defined in symbol table and if not, add to unknownSymbol table for later validation
             insertSymbol($1->value,NULL,&unknownSymbol); // insert the unknown symbol to unknownSymbol table and validate at the end
         }
-        $$ = createNode("SUBSTITUTE", "${ }",$1,NULL);
+        $$ = createNode(NODE_SUBSTITUTE, "${ }",$1,NULL);
     }
     | error { 
         yyerror(code[3].msg); yyerrok; return 1;
     };
 
 range: LBIG multiregterm RBIG { // Range = [ ] with no ^
-        $$ = createNode("RANGE","[]",$2,NULL);
+        $$ = createNode(NODE_RANGE,"[]",$2,NULL);
         minusflag=0; // reset the minus flag
-        freeAST(leftMinus); // free the leftMinus node
         leftMinus=NULL; // reset the leftMinus node
     }
     | LBIG CAP multiregterm RBIG { // Range = [^ ]
-        $$ = createNode("NEGRANGE","[^]",$3,NULL);
+        $$ = createNode(NODE_NEGRANGE,"[^]",$3,NULL);
         minusflag=0; // reset the minus flag
-        freeAST(leftMinus); // free the leftMinus node
         leftMinus=NULL; // reset the leftMinus node
     };
 
 wild: WILD { // i.e. '.' 
-        $$ = createNode("WILD",".",NULL,NULL);
+        $$ = createNode(NODE_WILD,".",NULL,NULL);
     };
 
 substitute: LCUR ID RCUR { // case of ${ }
-        $$ = createNode("ID", $2, NULL, NULL); 
+        $$ = createNode(NODE_ID, $2, NULL, NULL); 
     };
 
 // for one or more characters in range i.e. [ ]
 multiregterm: regterm { // only one character inside range
         $$ = $1;
         if(!minusflag){ // called for the first term in range and we assign it as left
-            leftMinus=createNode($1->type,$1->value,$1->left,$1->right); // copy the current node to leftMinus
+            leftMinus=$1; // the current node is the left end of a possible range
         }
     }
     | multiregterm regterm { //more than one characters
-        $$ = createNode("RANGE_VAL", NULL, $1, $2);
+        $$ = createNode(NODE_RANGE_VAL, NULL, $1, $2);
 
         /*
             This part handles the range validation for unicode characters. We assign each node to leftMinus and replace recursively until we get a minus.
             After minus, we get the next node and first, check if the left node and right node are unicode. We can extend this to other types too as well.
             Also, if one of the two is unicode, the other needs to be as well. Then, we compare the values and check if range is valid. If not, throw error.
-            If the range is valid, we free the leftMinus node and reset the leftMinus node and minusflag for next range.
+            If the range is valid, we reset the leftMinus node and minusflag for next range.
         */
 
-        if($2 && strcmp($2->type,"MINUS")==0 && leftMinus!=NULL){ // check if the character is minus and left node is set, then set flag
+        if($2 && $2->kind==NODE_MINUS && leftMinus!=NULL){ // check if the character is minus and left node is set, then set flag
             minusflag = 1;
         }
-        else if(!minusflag && $2 && strcmp($2->type,"MINUS")!=0){ // if minus is not set and the current node is not "-", then set it to leftMinus
-            freeAST(leftMinus); // clear previous allocation and reallocate
-            leftMinus=createNode($2->type,$2->value,$2->left,$2->right); // allocate leftMinus to current node
+        else if(!minusflag && $2 && $2->kind!=NODE_MINUS){ // if minus is not set and the current node is not "-", then set it to leftMinus
+            leftMinus=$2; // the current node is the left end of a possible range
         }
         else if(leftMinus!=NULL){ // check if the left node is present
-            int leftUni=strcmp(leftMinus->type,"UNICODE"); // check if left node is unicode
-            int rightUni=strcmp($2->type,"UNICODE"); // check if right node is unicode
             long left, right;
-            if(leftUni==0){
-                sscanf(leftMinus->value, "%%x%lx;", &left); // extract long from leftMinus unicode
+            if(leftMinus->kind==NODE_UNICODE){ // decoded by the lexer rule below
+                left = leftMinus->code;
             }
             else{
                 int len = strlen(leftMinus->value);
                 left = (int)leftMinus->value[len-1];
             }
-            if(rightUni==0){
-                sscanf($2->value, "%%x%lx;", &right); // extract long from current unicode
+            if($2->kind==NODE_UNICODE){
+                right = $2->code;
             }
             else{
                 right = (int)$2->value[0];
@@ -296,8 +281,7 @@ multiregterm: regterm { // only one character inside range
                 yyerror(code[2].msg);
                 return 1;
             }
-            freeAST(leftMinus); // free the leftMinus node after use
-            leftMinus=NULL; // set to null
+            leftMinus=NULL; // range checked, wait for the next one
             minusflag=0; // reset minus flag
         }
         else{
@@ -311,13 +295,13 @@ regterm: anychar { // for characters which are not part of tokens eg: #, @,`, et
         $$ = $1;
     }
     | ESC RBIG { // used \] to use ] or can use unicode but question mentions only for literals
-        $$ = createNode("RBIG","]",NULL,NULL);
+        $$ = createNode(NODE_RBIG,"]",NULL,NULL);
     } 
     | QUOTE {  // [ " ] use of quote inside [ ]
-        $$ = createNode("QUOTE","\"",NULL,NULL);
+        $$ = createNode(NODE_QUOTE,"\"",NULL,NULL);
     }
     | PERCENT { // % needs to be escaped in literals but is not compulsory for range. So, use the % character
-        $$ = createNode("PERCENT","%%",NULL,NULL);
+        $$ = createNode(NODE_PERCENT,"%%",NULL,NULL);
     };
 
 // multiple characters inside double quotes
@@ -325,7 +309,7 @@ multiliteral: literal { // for only one character inside " "
         $$ = $1;
     }
     | multiliteral literal { // for multiple characters inside " "
-        $$ = createNode("LITERAL", NULL, $1, $2);
+        $$ = createNode(NODE_LITERAL, NULL, $1, $2);
     };
 
 literal: anychar { // represents all characters that are possible inside " " except ], " and %
@@ -333,28 +317,28 @@ literal: anychar { // represents all characters that are possible inside " " exc
     }
     /* | ESC QUOTE { $$=malloc(strlen($2)+2); sprintf($$,"\\\"",$2);} //this works too \" but used unicode */
     | RBIG { // ] since it is not part of anychar
-        $$= createNode("RBIG","]",NULL,NULL); 
+        $$= createNode(NODE_RBIG,"]",NULL,NULL); 
     };
 
 // includes all the tokens defined which can exist inside literals or range too
-anychar: PLUS { $$= createNode("PLUS","+",NULL,NULL);  } // '+'
-    | MINUS { $$= createNode("MINUS","-",NULL,NULL);  } // '-'
-    | CONST_TOK { $$= createNode("CONST","const",NULL,NULL); } // 'const'
-    | EQUAL { $$= createNode("EQUAL","=",NULL,NULL); } // '='
-    | AMP { $$= createNode("AMP","&",NULL,NULL); } // '&'
-    | NOT { $$= createNode("NOT","!",NULL,NULL); } // '!'
-    | LPAR { $$= createNode("LPAR","(",NULL,NULL); } // '('
-    | RPAR { $$= createNode("RPAR",")",NULL,NULL); } // ')'
-    | PIPE { $$= createNode("PIPE","|",NULL,NULL); } // '|'
-    | QUES { $$= createNode("QUES","?",NULL,NULL); } // '?'
-    | LBIG { $$= createNode("LBIG","[",NULL,NULL); } // '['
-    | ESC ESC { $$= createNode("ESC","\\",NULL,NULL); } // '\\'
-    | ASTRK { $$= createNode("ASTRK","*",NULL,NULL); } // '*'
-    | WILD {  $$ = createNode("DOT",".",NULL,NULL); }; // '.'
-    | LCUR { $$= createNode("LCUR","${",NULL,NULL); } // '${'
-    | RCUR { $$= createNode("RCUR","}",NULL,NULL); } // '}'
-    | ID { $$= createNode("ID",$1,NULL,NULL); clearYylval();} // alphanumeric tokens
-    | OTHERCHAR { $$= createNode("OTHERS",$1,NULL,NULL); clearYylval();} // includes all other characters except tokens
+anychar: PLUS { $$= createNode(NODE_PLUS,"+",NULL,NULL);  } // '+'
+    | MINUS { $$= createNode(NODE_MINUS,"-",NULL,NULL);  } // '-'
+    | CONST_TOK { $$= createNode(NODE_CONST,"const",NULL,NULL); } // 'const'
+    | EQUAL { $$= createNode(NODE_EQUAL,"=",NULL,NULL); } // '='
+    | AMP { $$= createNode(NODE_AMP,"&",NULL,NULL); } // '&'
+    | NOT { $$= createNode(NODE_NOT,"!",NULL,NULL); } // '!'
+    | LPAR { $$= createNode(NODE_LPAR,"(",NULL,NULL); } // '('
+    | RPAR { $$= createNode(NODE_RPAR,")",NULL,NULL); } // ')'
+    | PIPE { $$= createNode(NODE_PIPE,"|",NULL,NULL); } // '|'
+    | QUES { $$= createNode(NODE_QUES,"?",NULL,NULL); } // '?'
+    | LBIG { $$= createNode(NODE_LBIG,"[",NULL,NULL); } // '['
+    | ESC ESC { $$= createNode(NODE_ESC,"\\",NULL,NULL); } // '\\'
+    | ASTRK { $$= createNode(NODE_ASTRK,"*",NULL,NULL); } // '*'
+    | WILD {  $$ = createNode(NODE_DOT,".",NULL,NULL); }; // '.'
+    | LCUR { $$= createNode(NODE_LCUR,"${",NULL,NULL); } // '${'
+    | RCUR { $$= createNode(NODE_RCUR,"}",NULL,NULL); } // '}'
+    | ID { $$= createNode(NODE_ID,$1,NULL,NULL); clearYylval();} // alphanumeric tokens
+    | OTHERCHAR { $$= createNode(NODE_OTHERS,$1,NULL,NULL); clearYylval();} // includes all other characters except tokens
     | UNICODE { 
         // Extract the Unicode value using sscanf
         long x = 0;
@@ -367,7 +351,8 @@ anychar: PLUS { $$= createNode("PLUS","+",NULL,NULL);  } // '+'
             yyerror(code[5].msg); 
             return 1;
         }
-        $$ = createNode("UNICODE", $1, NULL, NULL);
+        $$ = createNode(NODE_UNICODE, $1, NULL, NULL);
+        $$->code = x; // decoded once, the generator never parses the text again
         clearYylval();
     }; // includes the unicode formatted
 
@@ -384,29 +369,87 @@ void clearYylval(){ // function to clear yylval which is done after every token
     }
 }
 
-void cleanUp(){ // clean up the symbol table, file pointer and yylval at the end
-    freeSymbolTable(symbolTable); // free the symbol table
-    freeSymbolTable(unknownSymbol); // free the unknown symbol table, if any
+void cleanUp(){ // clean up the symbol tables, ASTs, file pointer and yylval at the end
+    releaseAST(); // every AST node, symbol and interned string at once
+    releaseStates(); // the NFA of --set, or what an error left behind
+    symbolTable = unknownSymbol = NULL;
     if(yyin){ // close file if opened
         fclose(yyin);
     }
-    for(int i=0;i<symbolCount;i++){ // free the temporary holder for ASTs
-        if(tempholder[i]!=NULL){
-            freeAST(tempholder[i]);
-        }
-    }
     clearYylval(); // clear yylval
 }
 
 int main(int argc, char *argv[]) {
-    if(argc == 3){ // check for third argument as debug
-        int var = atoi(argv[2]); // the argument is considered as string so convert to int
-        if(var==0 || var == 1){ //check if it is 1 or 0, else throw error
-            debugging = var;
+    if(argc == 3 && strcmp(argv[1], "--driver") == 0){ // the input handling of rexec, built into runner/runner
+        FILE *f = fopen(argv[2], "w");
+        if(!f){
+            perror(argv[2]);
+            return 1;
         }
-        else{
-            printf("Invalid debugging argument (1 or 0). Setting to 0 instead\n");
+        verdictCode(f, 0);
+        driverCode(f);
+        return fclose(f) != 0;
+    }
+    cacheDir = getenv("REXEC_CACHE_DIR"); // --cache-dir= below takes precedence
+    if(cacheDir && !cacheDir[0]) cacheDir = NULL;
+    for(int i = 2; i < argc; i++){ // options after the filepath
+        if(strcmp(argv[i], "--dfa") == 0){ // emit a table driven DFA instead of the NFA runner
+            genMode = GEN_DFA;
+        }
+        else if(strcmp(argv[i], "--goto") == 0){ // emit the DFA as direct coded labels and goto
+            genMode = GEN_GOTO;
+        }
+        else if(strcmp(argv[i], "--nfa") == 0){ // always emit the linked State/Transition runner
+            bitParallel = 0;
+        }
+        else if(strcmp(argv[i], "--no-prefilter") == 0){ // skip the required literal checks in rexec.c
+            prefilterEnabled = 0;
+        }
+        else if(strcmp(argv[i], "--lazy") == 0){ // build DFA states on demand at runtime
+            genMode = GEN_LAZY;
+        }
+        else if(strcmp(argv[i], "--match") == 0 && i + 1 < argc){ // match one input here instead of writing rexec.c
+            matchPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--lib") == 0){ // write rexec.h and a reentrant rexec.c without main()
+            genMode = GEN_LIB;
         }
+        else if(strcmp(argv[i], "--save") == 0){ // write the DFA as rexec.fsm for the generic runner
+            genMode = GEN_SAVE;
+        }
+        else if(strncmp(argv[i], "--cache=", 8) == 0){ // memory budget in bytes for the lazy DFA cache
+            lazyCacheBudget = atol(argv[i] + 8);
+            if(lazyCacheBudget <= 0){
+                printf("Invalid cache budget %s\n", argv[i] + 8);
+                return 1;
+            }
+        }
+        else if(strncmp(argv[i], "--cache-dir=", 12) == 0){ // reuse generated files of unchanged patterns from this directory
+            cacheDir = argv[i][12] ? argv[i] + 12 : NULL;
+        }
+        else if(strcmp(argv[i], "--set") == 0){ // one DFA for every system of the file, reporting which ones match
+            setMode = 1;
+        }
+        else if(strcmp(argv[i], "--stats") == 0){ // report DFA state counts before and after minimization
+            dfaStats = 1;
+        }
+        else if(strncmp(argv[i], "--", 2) == 0){
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else{ // check for third argument as debug
+            int var = atoi(argv[i]); // the argument is considered as string so convert to int
+            if(var==0 || var == 1){ //check if it is 1 or 0, else throw error
+                debugging = var;
+            }
+            else{
+                printf("Invalid debugging argument (1 or 0). Setting to 0 instead\n");
+            }
+        }
+    }
+    if(setMode && (matchPath || (genMode != GEN_NFA && genMode != GEN_DFA))){
+        printf("--set only builds the table DFA\n");
+        return 1;
     }
     char out_path[200];
     if (argc >= 2) { // second argument is filepath 
@@ -429,16 +472,33 @@ int main(int argc, char *argv[]) {
         printf("Please provide an input:\n");
         return 1;
     }
-    if(strlen(out_path)>0){
-        out_c_file = fopen(out_path, "w");
+    if(matchPath){ // nothing is written, the input is matched in process
+        out_c_file = NULL;
+    }
+    else if(genMode == GEN_SAVE){ // a binary automaton next to where rexec.c would go
+        if(strlen(out_path)>0 && strlen(out_path) + 2 < sizeof(out_path)) strcpy(out_path + strlen(out_path) - 1, "fsm");
+        else strcpy(out_path, "rexec.fsm");
+        out_c_file = openOutput(out_path);
+    }
+    else if(strlen(out_path)>0){
+        out_c_file = openOutput(out_path);
     }
     else{
-        out_c_file = fopen("rexec.c", "w");
+        out_c_file = openOutput("rexec.c");
     }
-    if (!out_c_file) {
+    if (!out_c_file && !matchPath) {
         perror("Could not create rexec.c");
         return 1;
     }
+    if(genMode == GEN_LIB && !matchPath){ // the header goes next to rexec.c
+        if(strlen(out_path)>0) strcpy(out_path + strlen(out_path) - 1, "h");
+        else strcpy(out_path, "rexec.h");
+        libHeader = openOutput(out_path);
+        if (!libHeader) {
+            perror("Could not create rexec.h");
+            return 1;
+        }
+    }
 
     if(yyparse()==0){ // if regular expression is correct, parser will return 0, else 1
         Symbol *temp = unknownSymbol;
@@ -450,18 +510,19 @@ int main(int argc, char *argv[]) {
             temp=temp->next;
         }
 
-        printf("accepts\n");
+        if(setMode) setCode(out_c_file); // every pattern is known now
+        if(!matchPath) printf("accepts\n");
         if(debugging){
             printSymbolTable(symbolTable);
         }
-        fclose(out_c_file);
+        int written = closeOutputs(1); // rexec.c (and rexec.h) only change when their text did
 
         cleanUp(); // clean up at the end
-        exit(0);
+        exit(written ? matchFailed : 1);
     }
     else{
         printf("Exiting due to error.\n");
-        fclose(out_c_file);
+        closeOutputs(0); // a failed parse leaves the previous rexec.c in place
         cleanUp(); // clean up at the end
         exit(1);
     }
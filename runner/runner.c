@@ -0,0 +1,121 @@
+/*
+    Generic runner for binary automaton files (generate --save). Built once, it matches any
+    pattern: the file is mapped read only, so loading is instant and every process using the
+    same pattern shares its pages.
+
+    ./runner pattern.fsm [-r | -l] [-c] [-j N] [input ...]
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../lib/Automaton.h"
+
+#define CHUNK_SIZE 65536 // bytes read at a time from a streamed input
+
+AutomatonHeader hostHeader; // the header of the file with host numbers
+const AutomatonHeader *header = NULL;
+const uint32_t *table = NULL;
+const uint8_t *accept = NULL;
+
+// map the automaton and check it before any of it is used; returns 0 on failure. The table is
+// used in place when this host is little endian and converted into memory otherwise
+int loadAutomaton(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        return 0;
+    }
+    void *p = st.st_size >= (off_t)sizeof(AutomatonHeader)
+        ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "%s: not an automaton file\n", path);
+        return 0;
+    }
+    const AutomatonHeader *raw = (const AutomatonHeader *)p;
+    hostHeader = *raw;
+    hostHeader.version = automatonLe32(&raw->version);
+    hostHeader.states = automatonLe32(&raw->states);
+    hostHeader.classes = automatonLe32(&raw->classes);
+    hostHeader.start = automatonLe32(&raw->start);
+    hostHeader.settled = automatonLe32(&raw->settled);
+    header = &hostHeader;
+    if (memcmp(header->magic, AUTOMATON_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not an automaton file\n", path);
+        return 0;
+    }
+    if (header->version != AUTOMATON_VERSION) {
+        fprintf(stderr, "%s: automaton version %u, this runner reads %d\n", path, header->version, AUTOMATON_VERSION);
+        return 0;
+    }
+    if (header->states == 0 || automatonSize(header) != (uint64_t)st.st_size
+        || header->start >= header->states || header->settled > header->states) {
+        fprintf(stderr, "%s: corrupt automaton file\n", path);
+        return 0;
+    }
+    uint64_t cells = (uint64_t)header->states * header->classes;
+    table = (const uint32_t *)(raw + 1);
+    accept = (const uint8_t *)(table + cells);
+    if (!automatonHostOrder()) {
+        uint32_t *copy = (uint32_t *)malloc(cells * sizeof(uint32_t));
+        if (!copy) {
+            perror(path);
+            return 0;
+        }
+        for (uint64_t i = 0; i < cells; i++) copy[i] = automatonLe32(table + i);
+        table = copy;
+    }
+    for (int c = 0; c < 256; c++) {
+        if (header->byteClass[c] >= header->classes) {
+            fprintf(stderr, "%s: corrupt automaton file\n", path);
+            return 0;
+        }
+    }
+    for (uint64_t i = 0; i < cells; i++) {
+        if (table[i] >= header->states) {
+            fprintf(stderr, "%s: corrupt automaton file\n", path);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// advance from state over one chunk, stopping once the verdict is settled
+uint32_t scan(const unsigned char *input, long len, uint32_t state) {
+    const uint32_t classes = header->classes, settled = header->settled;
+    for (long i = 0; i < len && state >= settled; ++i)
+        state = table[state * classes + header->byteClass[input[i]]];
+    return state;
+}
+
+int match_stream(FILE *f) {
+    static unsigned char buf[CHUNK_SIZE];
+    uint32_t state = header->start;
+    size_t n;
+    while (state >= header->settled && (n = fread(buf, 1, CHUNK_SIZE, f)) > 0) state = scan(buf, n, state);
+    return accept[state];
+}
+
+int match_record(const unsigned char *input, long len) {
+    return accept[scan(input, len, header->start)];
+}
+
+#define REENTRANT_MATCH // scan() only reads the mapped automaton
+
+#include "driver.c" // written by generate --driver: the same options and output as rexec
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s pattern.fsm [-r | -l] [-c] [-j N] [input ...]\n", argv[0]);
+        return 2;
+    }
+    if (!loadAutomaton(argv[1])) return 2;
+    return run_inputs(argc - 1, argv + 1);
+}
@@ -1,10 +1,37 @@
 #!/usr/bin/env python3
+import hashlib
+import os
+import shutil
+import struct
 import subprocess
 from pathlib import Path
 import signal
-
-def run(cmd, cwd=None):
-    proc = subprocess.Popen(cmd, cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+import sys
+import tempfile
+
+# Every backend runs the whole suite: each verdict is compared with groundtruth.txt and with the
+# verdicts of the other backends. kind says how the output is run, modes which options of the
+# matcher are checked on top of one input per run:
+#   records  -r, -l and -c over all strings of the pattern at once
+#   files    several paths in one run, with -j 2
+#   chunks   a 4 MB file made of the pattern's strings, run with -j 4 (split into chunks) and without
+#   big      the same file run normally, its verdict has to agree across these backends
+BACKENDS = [
+    ("default",    [],                    "program", {"records", "files", "big"}),
+    ("nfa",        ["--nfa"],             "program", {"records", "files", "big"}),
+    ("dfa",        ["--dfa"],             "program", {"records", "files", "chunks", "big"}),
+    ("goto",       ["--goto"],            "program", {"records", "files", "big"}),
+    ("lazy",       ["--lazy"],            "program", {"records", "files", "big"}),
+    ("lazy-flush", ["--lazy", "--cache=1"], "program", {"records"}), # flushes before every new state
+    ("set",        ["--set"],             "program", {"records", "files"}),
+    ("lib",        ["--lib"],             "lib",     set()),
+    ("save",       ["--save"],            "runner",  {"records", "files", "big"}),
+    ("match",      ["--match"],           "match",   {"big"}),
+]
+CHUNKED_SIZE = 4 << 20 # smallest regular file -j splits into chunks
+
+def run(cmd, cwd=None, env=None):
+    proc = subprocess.Popen(cmd, cwd=cwd, env=env, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
     out, err = proc.communicate()
     rc = proc.returncode
     if rc < 0:
@@ -19,85 +46,198 @@ def load_groundtruth(gt_path):
         parts = line.split()
         if len(parts) >= 3:
             key = (parts[0], parts[1])
-            gt[key] = parts[2]
+            gt[key] = " ".join(parts[2:]) # --set answers list the matching patterns
     return gt
 
-def main():
-    root        = Path(__file__).parent.resolve()
-    regex_dir   = root / "tests" / "regex"
-    strings_dir = root / "tests" / "strings"
-    gt_path     = root / "tests" / "groundtruth.txt"
-    results     = root / "tests" / "test_results.txt"
-    comp        = root / "tests" / "comparison.txt"
-
-    # Load expected answers
-    if not gt_path.exists():
-        print(f"ERROR: groundtruth.txt not found at {gt_path}")
-        return
-    groundtruth = load_groundtruth(gt_path)
-
-    # fresh start
-    for p in (results, comp):
-        if p.exists(): p.unlink()
-
-    total = passed = failed = 0
-
-    with results.open("w") as fout, comp.open("w") as cmpf:
-        for rx in sorted(regex_dir.glob("*.txt")):
-            base   = rx.stem
-            # binary = root / f"rexec_{base}"
-            binary = root / f"rexec"
-
-            # 1) generate
-            code, out, err = run([str(root/"generate"), str(rx)])
+def select_backends(args):
+    # no arguments: every backend; names pick some of them; options make one more backend from them
+    names = [a for a in args if not a.startswith("-")]
+    flags = [a for a in args if a.startswith("-")]
+    chosen = [b for b in BACKENDS if b[0] in names] if names else ([] if flags else list(BACKENDS))
+    unknown = set(names) - {b[0] for b in BACKENDS}
+    if unknown:
+        sys.exit(f"Unknown backend {', '.join(sorted(unknown))}; one of {', '.join(b[0] for b in BACKENDS)}")
+    if flags:
+        kind = "match" if "--match" in flags else "lib" if "--lib" in flags else "runner" if "--save" in flags else "program"
+        chosen.append((" ".join(flags), flags, kind, {"records", "files"} if kind in ("program", "runner") else set()))
+    return chosen
+
+class Suite:
+    def __init__(self, root):
+        self.root        = root
+        self.regex_dir   = root / "tests" / "regex"
+        self.strings_dir = root / "tests" / "strings"
+        self.cache_dir   = Path(os.environ.get("REXEC_CACHE_DIR") or root / ".rexec-cache")
+        os.environ["REXEC_CACHE_DIR"] = str(self.cache_dir)
+        self.groundtruth = load_groundtruth(root / "tests" / "groundtruth.txt")
+        self.total = self.passed = self.failed = 0
+        self.per_backend = {}
+        self.single_set = False
+
+    def record(self, backend, name, what, exp, actual, ok):
+        self.cmpf.write(f"{backend} {name} {what} {exp} {actual} {'PASS' if ok else 'FAIL'}\n")
+        counts = self.per_backend.setdefault(backend, [0, 0])
+        counts[0] += 1
+        counts[1] += ok
+        self.total += 1
+        if ok:
+            self.passed += 1
+        else:
+            self.failed += 1
+
+    # build the matcher of one pattern; returns the command to run it or an error string
+    def build(self, rx, flags, kind):
+        if kind == "match":
+            return [str(self.root/"generate"), str(rx)] + flags # the input follows --match
+        code, out, err = run([str(self.root/"generate"), str(rx)] + flags)
+        if code != 0:
+            return f"GENERATE_ERROR {err or out}"
+        if kind == "runner": # one runner/runner for every pattern, the automaton is kept by its hash
+            data = (self.regex_dir/"rexec.fsm").read_bytes()
+            fsm = self.cache_dir / f"{hashlib.sha256(data).hexdigest()[:16]}.fsm"
+            if not fsm.exists():
+                self.cache_dir.mkdir(parents=True, exist_ok=True)
+                fsm.write_bytes(data)
+            return [str(self.root/"runner"/"runner"), str(fsm)]
+
+        # compile, unless a binary of the same sources is cached
+        sources = [self.regex_dir/"rexec.c"]
+        compile_cmd = ["gcc", str(self.regex_dir/"rexec.c"), "-pthread", "-o"]
+        if kind == "lib": # tests/libmain.c turns the library into a program
+            sources += [self.regex_dir/"rexec.h", self.root/"tests"/"libmain.c"]
+            compile_cmd[2:2] = [str(self.root/"tests"/"libmain.c"), f"-I{self.regex_dir}"]
+        digest = hashlib.sha256(b"".join(p.read_bytes() for p in sources) + " ".join(compile_cmd[2:]).encode()).hexdigest()
+        binary = self.cache_dir / f"{digest[:16]}.bin"
+        if not binary.exists():
+            self.cache_dir.mkdir(parents=True, exist_ok=True)
+            tmp = self.cache_dir / f"{digest[:16]}.{os.getpid()}.tmp"
+            code, out, err = run(compile_cmd + [str(tmp)])
             if code != 0:
-                actual = f"GENERATE_ERROR"
-                # no string tests in this case; record as failure for each
-                # but here we just log the generate error line
-                fout.write(f"{rx.name} -- {actual} -- {err or out}\n")
-                total += 1
-                exp = groundtruth.get((rx.name, ""), "N/A")
-                cmpf.write(f"{rx.name} <no-string> {exp} {actual} FAIL\n")
-                failed += 1
+                return f"COMPILE_ERROR {err or out}"
+            tmp.replace(binary)
+        return [str(binary)]
+
+    # output lines of cmd, the patterns matched by a set of one are left out like the plain programs do
+    def lines(self, cmd, args):
+        code, out, err = run(cmd + args)
+        if code != 0:
+            return ["RUNTIME_ERROR"]
+        if self.single_set:
+            return [l[:-2] if l.endswith("ACCEPTS 0") else l for l in out.splitlines()]
+        return out.splitlines()
+
+    def verdict(self, cmd, path, extra=()):
+        return "\n".join(self.lines(cmd, list(extra) + [str(path)])) or "<no output>"
+
+    # -r, -l and -c over every string at once must repeat the verdicts of the single runs
+    def check_records(self, backend, rx, cmd, flags, strings, single, work):
+        lines = [(st, data) for st, data in strings if b"\n" not in data]
+        rfile, lfile = work/"records.txt", work/"records.bin"
+        rfile.write_bytes(b"".join(data + b"\n" for _, data in lines))
+        lfile.write_bytes(b"".join(struct.pack("<I", len(data)) + data for _, data in strings))
+        for option, path, subset in (("-r", rfile, lines), ("-l", lfile, strings)):
+            exp = [single[st] for st, _ in subset]
+            got = self.lines(cmd, [option, str(path)])
+            self.record(backend, rx.name, f"<records {option}>", len(exp), sum(map(str.__eq__, exp, got)), got == exp)
+            if "--set" not in flags: # --set counts per pattern instead
+                exp_c = [f"ACCEPTS {exp.count('ACCEPTS')}", f"REJECTS {len(exp) - exp.count('ACCEPTS')}"]
+                got_c = self.lines(cmd, [option, "-c", str(path)])
+                self.record(backend, rx.name, f"<records {option} -c>", "/".join(exp_c).replace(" ", "="),
+                            "/".join(got_c).replace(" ", "="), got_c == exp_c)
+
+    # several inputs in one run give "path: verdict" lines in order
+    def check_files(self, backend, rx, cmd, strings, single):
+        if len(strings) < 2:
+            return
+        paths = [str(self.strings_dir/st) for st, _ in strings]
+        got = self.lines(cmd, ["-j", "2"] + paths)[:len(paths)]
+        exp = [f"{p}: {single[st]}" for p, (st, _) in zip(paths, strings)]
+        self.record(backend, rx.name, "<files -j 2>", len(exp), sum(map(str.__eq__, exp, got)), got == exp)
+
+    def run_pattern(self, rx, backends, work):
+        base = rx.stem
+        strings = [(st.name, st.read_bytes()) for st in sorted(self.strings_dir.glob(f"{base}_*.txt"))]
+        big = None
+        if any("big" in b[3] or "chunks" in b[3] for b in backends) and strings:
+            seed = max((data for _, data in strings), key=len) or b"\n"
+            big = work/"big.txt"
+            big.write_bytes(seed * (CHUNKED_SIZE // len(seed) + 1))
+        seen = {} # (string, verdict) -> backends, to check them against each other
+
+        for backend, flags, kind, modes in backends:
+            if base.startswith("set_") and "--set" not in flags: # several patterns only make sense as a set
                 continue
-
-            # 2) compile
-            code, out, err = run(["gcc", str(regex_dir/"rexec.c"), "-o", str(regex_dir/str(binary))])
-            if code != 0:
-                actual = "COMPILE_ERROR"
-                fout.write(f"{rx.name} -- {actual} -- {err or out}\n")
-                total += 1
-                exp = groundtruth.get((rx.name, ""), "N/A")
-                cmpf.write(f"{rx.name} <no-string> {exp} {actual} FAIL\n")
-                failed += 1
+            cmd = self.build(rx, flags, kind)
+            if isinstance(cmd, str):
+                self.fout.write(f"{backend} {rx.name} -- {cmd}\n")
+                self.record(backend, rx.name, "<no-string>", self.groundtruth.get((rx.name, ""), "N/A"), cmd.split()[0], False)
                 continue
+            self.single_set = "--set" in flags and not base.startswith("set_")
+            single = {}
+            for st, _ in strings:
+                actual = self.verdict(cmd, self.strings_dir/st)
+                single[st] = actual
+                self.fout.write(f"{backend} {rx.name} {st} {actual}\n")
+                exp = self.groundtruth.get((rx.name, st), None)
+                self.record(backend, rx.name, st, exp or "MISSING", actual, exp == actual)
+                seen.setdefault((st, actual), []).append(backend)
+            if "records" in modes and strings:
+                self.check_records(backend, rx, cmd, flags, strings, single, work)
+            if "files" in modes:
+                self.check_files(backend, rx, cmd, strings, single)
+            if big and "big" in modes:
+                seen.setdefault(("<big>", self.verdict(cmd, big)), []).append(backend)
+            if big and "chunks" in modes:
+                whole, chunked = self.verdict(cmd, big), self.verdict(cmd, big, ["-j", "4"])
+                self.record(backend, rx.name, "<chunks -j 4>", whole, chunked, whole == chunked)
+
+        # the backends have to agree with each other, also where groundtruth has no answer
+        for st in sorted({st for st, _ in seen}):
+            answers = {v: b for (s, v), b in seen.items() if s == st}
+            if len(answers) > 1:
+                self.record("all", rx.name, st, "AGREE", ";".join(f"{','.join(b)}={v}".replace(" ", "_") for v, b in answers.items()), False)
+            elif st == "<big>":
+                self.record("all", rx.name, st, "AGREE", "AGREE", True)
+
+    # --cache-dir: a miss and then a hit both give the text generated without any cache
+    def check_cache(self, rx, work):
+        env = dict(os.environ)
+        env.pop("REXEC_CACHE_DIR", None)
+        cache = work/"cache"
+        texts = []
+        for options in ([], [f"--cache-dir={cache}"], [f"--cache-dir={cache}"]):
+            code, out, err = run([str(self.root/"generate"), str(rx)] + options, env=env)
+            texts.append((self.regex_dir/"rexec.c").read_bytes() if code == 0 else None)
+        entries = len(list(cache.glob("*.c"))) if cache.exists() else 0
+        ok = texts[0] is not None and texts.count(texts[0]) == 3 and entries == 1
+        self.record("cache-dir", rx.name, "<miss,hit>", "SAME", "SAME" if ok else f"DIFFERENT({entries}_entries)", ok)
+        shutil.rmtree(cache, ignore_errors=True)
+
+    def main(self, backends):
+        results = self.root / "tests" / "test_results.txt"
+        comp    = self.root / "tests" / "comparison.txt"
+        for p in (results, comp): # fresh start
+            if p.exists(): p.unlink()
+        with results.open("w") as self.fout, comp.open("w") as self.cmpf, \
+                tempfile.TemporaryDirectory(prefix="runtest") as tmp:
+            work = Path(tmp)
+            for rx in sorted(self.regex_dir.glob("*.txt")):
+                self.run_pattern(rx, backends, work)
+                if any(b[0] == "default" for b in backends) and not rx.stem.startswith("set_"):
+                    self.check_cache(rx, work)
+
+        # summary
+        print(f"Done.\nResults: {results}\nComparison: {comp}")
+        for backend, (count, ok) in self.per_backend.items():
+            print(f"  {backend:<12} {ok}/{count}")
+        print(f"Total: {self.total}, Passed: {self.passed}, Failed: {self.failed}")
 
-            # 3) run string tests
-            for st in sorted(strings_dir.glob(f"{base}_*.txt")):
-                code, out, err = run([str(binary), str(st)])
-                if code == 0:
-                    actual = out or "<no output>"
-                else:
-                    actual = f"RUNTIME_ERROR"
-
-                # write actual results
-                fout.write(f"{rx.name} {st.name} {actual}\n")
-
-                # compare
-                exp = groundtruth.get((rx.name, st.name), None)
-                status = "PASS" if exp == actual else "FAIL"
-
-                cmpf.write(f"{rx.name} {st.name} {exp or 'MISSING'} {actual} {status}\n")
-
-                total += 1
-                if status == "PASS":
-                    passed += 1
-                else:
-                    failed += 1
-
-    # summary
-    print(f"Done.\nResults: {results}\nComparison: {comp}")
-    print(f"Total: {total}, Passed: {passed}, Failed: {failed}")
+def main():
+    root = Path(__file__).parent.resolve()
+    if not (root / "tests" / "groundtruth.txt").exists():
+        print(f"ERROR: groundtruth.txt not found at {root / 'tests' / 'groundtruth.txt'}")
+        return
+    Suite(root).main(select_backends(sys.argv[1:]))
 
 if __name__ == "__main__":
     main()
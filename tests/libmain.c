@@ -0,0 +1,47 @@
+/*
+    Driver for the --lib output in runtest.py: matches one file with rexec_match and again one
+    byte at a time through rexec_begin/rexec_feed/rexec_end, and prints ACCEPTS or REJECTS like
+    the generated programs. Exits with 2 when the two calls disagree.
+
+    gcc rexec.c tests/libmain.c -I<dir of rexec.h> -o libmain && ./libmain input
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rexec.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s input\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t len = 0, cap = 4096;
+    unsigned char *buf = (unsigned char *)malloc(cap);
+    for (size_t n; buf && (n = fread(buf + len, 1, cap - len, f)) > 0; ) {
+        len += n;
+        if (len == cap) buf = (unsigned char *)realloc(buf, cap *= 2);
+    }
+    fclose(f);
+    if (!buf) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    rexec_scratch whole, pieces;
+    int verdict = rexec_match(buf, len, &whole);
+    rexec_begin(&pieces);
+    for (size_t i = 0; i < len && rexec_feed(&pieces, buf + i, 1); i++); // stops once settled
+    free(buf);
+    if (rexec_end(&pieces) != verdict) {
+        fprintf(stderr, "rexec_match and rexec_feed disagree\n");
+        return 2;
+    }
+    printf(verdict ? "ACCEPTS\n" : "REJECTS\n");
+    return 0;
+}